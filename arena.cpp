@@ -0,0 +1,115 @@
+#include <iostream>
+#include <cstdlib>
+#include <new>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "arena.hpp"
+
+thread_local Arena* Arena::currentArena = nullptr;
+
+Arena::Arena(const char* name, size_t blockSize) : name(name), blockSize(blockSize), blocks(nullptr), next(nullptr), end(nullptr), bytes(0), objects(0), reserved(0) {
+}
+
+Arena::~Arena() {
+  while (blocks != nullptr) {
+    Block* b = blocks;
+    blocks = b->next;
+    free(b);
+  }
+
+  if (currentArena == this) {
+    currentArena = nullptr;
+  }
+}
+
+/** Slow path of allocate(): gets a new block from the heap.
+ *  Requests larger than the block size get a block of their own.
+ */
+void* Arena::grow(size_t size) {
+  size_t blockBytes = size > blockSize ? size : blockSize;
+
+  Block* b = (Block*)malloc(sizeof(Block) + blockBytes);
+  if (b == nullptr) {
+    throw bad_alloc();
+  }
+  b->size = blockBytes;
+  reserved += blockBytes;
+
+  char* data = (char*)(b + 1);
+
+  if (size > blockSize && blocks != nullptr) {
+    // keep bumping into the current block; the big one goes behind it
+    b->next = blocks->next;
+    blocks->next = b;
+    return data;
+  }
+
+  b->next = blocks;
+  blocks = b;
+
+  next = data + size;
+  end = data + blockBytes;
+
+  return data;
+}
+
+void Arena::reset() {
+  if (blocks == nullptr) {
+    return;
+  }
+
+  // keep the oldest block only (that's the last one in the chain)
+  Block* first = blocks;
+  while (first->next != nullptr) {
+    Block* b = first;
+    first = b->next;
+    reserved -= b->size;
+    free(b);
+  }
+
+  blocks = first;
+  next = (char*)(first + 1);
+  end = next + first->size;
+
+  bytes = 0;
+  objects = 0;
+}
+
+const char* Arena::getName() const {
+  return name;
+}
+
+size_t Arena::getBytes() const {
+  return bytes;
+}
+
+size_t Arena::getObjects() const {
+  return objects;
+}
+
+size_t Arena::getReserved() const {
+  return reserved;
+}
+
+void Arena::printOut(OutBuf& out) const {
+  out << name << ": " << bytes << " bytes in " << objects << " objects ("
+      << reserved << " bytes reserved)\n";
+}
+
+Arena* Arena::current() {
+  return currentArena;
+}
+
+void Arena::setCurrent(Arena* arena) {
+  currentArena = arena;
+}
+
+void* Arena::allocateCurrent(size_t size) {
+  if (currentArena == nullptr) {
+    return ::operator new(size);
+  }
+  return currentArena->allocate(size);
+}
@@ -0,0 +1,111 @@
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+/**
+ * @file arena.hpp
+ * @brief This header file contains the bump allocator that owns
+ * the objects created while compiling a program.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include "outbuf.hpp"
+
+/** A bump ("arena") allocator.
+ *  Memory is carved out of large blocks by advancing a pointer, and it
+ *  is never given back piece by piece: reset() releases everything that
+ *  was allocated from the arena at once. Hence, objects allocated from an
+ *  Arena are never destroyed, and must not own resources of their own.
+ *
+ *  Addresses and attributes are allocated from the *current* arena (see
+ *  Address::operator new and Attribute::operator new), so the grammar
+ *  actions can keep using plain new.
+ */
+class Arena {
+private:
+  /* Header of a block; its storage follows immediately */
+  struct Block {
+    Block* next;
+    std::size_t size;
+  };
+
+  const char* name;
+  std::size_t blockSize;
+
+  Block* blocks;
+  char* next;
+  char* end;
+
+  std::size_t bytes;
+  std::size_t objects;
+  std::size_t reserved;
+
+  static thread_local Arena* currentArena;
+
+  void* grow(std::size_t size);
+
+  // Stop the compiler from generating methods of copy the object
+  Arena(Arena const& copy);            // Not to be implemented
+  Arena& operator=(Arena const& copy); // Not to be implemented
+public:
+  /** All allocations are aligned to (and rounded up to) this many bytes */
+  static const std::size_t ALIGN = 8;
+
+  /** Constructor; the arena does not reserve any memory until the first allocation.
+   *  @param name A name for the arena, used when printing its statistics
+   *  @param blockSize The size of the blocks the arena gets from the heap
+   */
+  Arena(const char* name, std::size_t blockSize = 64 * 1024);
+
+  /** Destructor; gives all the blocks back to the heap */
+  ~Arena();
+
+  /** Allocates size bytes; in the common case this is just a pointer increment */
+  void* allocate(std::size_t size) {
+    size = (size + ALIGN - 1) & ~(ALIGN - 1);
+
+    bytes += size;
+    objects++;
+
+    if ((std::size_t)(end - next) < size) {
+      return grow(size);
+    }
+
+    void* p = next;
+    next += size;
+    return p;
+  }
+
+  /** Releases everything allocated from the arena at once.
+   *  The first block is kept, to be reused by the next compilation.
+   */
+  void reset();
+
+  /** Returns the name of the arena */
+  const char* getName() const;
+
+  /** Returns the number of bytes allocated since the last reset */
+  std::size_t getBytes() const;
+
+  /** Returns the number of objects allocated since the last reset */
+  std::size_t getObjects() const;
+
+  /** Returns the number of bytes currently obtained from the heap */
+  std::size_t getReserved() const;
+
+  /** Prints out the statistics of the arena */
+  void printOut(OutBuf& out) const;
+
+  /** Returns the arena new objects are allocated from by the calling thread (NULL if none) */
+  static Arena* current();
+
+  /** Sets the arena new objects are allocated from by the calling thread.
+   *  When set to NULL, objects are allocated from the heap.
+   */
+  static void setCurrent(Arena* arena);
+
+  /** Allocates from the current arena, or from the heap when there is none */
+  static void* allocateCurrent(std::size_t size);
+};
+
+#endif //ARENA_HPP_
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <cstdio>
+
+using namespace std;
+
+#include "batch.hpp"
+
+Batch::Batch(const vector<string>& files, const Options& opt, int jobs, Cache* cache)
+  : files(files), opt(opt), jobs(jobs < 1 ? 1 : jobs), cache(cache), results(files.size()), next(0) {
+}
+
+/** Compiles one program (unless it is found in the cache), keeping what it prints in out and err */
+int Batch::compile(const string& file, string& out, string& err) {
+  FILE* in = fopen(file.c_str(), "r");
+  if (in == nullptr) {
+    err = "Can not open " + file + "\n";
+    return 1;
+  }
+
+  SourceBuffer src;
+  src.map(fileno(in));
+
+  auto build = [in, &src](const Options& opt, Checkpoints* checkpoints, string& printed, string& errors) {
+    ostringstream outs, errs;
+    int res;
+    try {
+      CompilerContext ctx(errs);
+      ctx.checkpoints = checkpoints;
+      OutBuf buf(outs);
+      res = ctx.compile(in, src, opt, buf);
+    } catch (const exception& e) {
+      // a failed compilation must not take the other ones down
+      errs << e.what() << endl;
+      res = 1;
+    }
+    printed = outs.str();
+    errors = errs.str();
+    return res;
+  };
+
+  int res = cache != nullptr ? cache->compile(src, opt, build, out, err) : build(opt, nullptr, out, err);
+  fclose(in);
+  return res;
+}
+
+/** The body of each thread: compiles programs until there are none left */
+void Batch::work() {
+  for (;;) {
+    size_t i;
+    {
+      lock_guard<mutex> guard(lock);
+      if (next >= files.size()) {
+        return;
+      }
+      i = next++;
+    }
+
+    string out, err;
+    int status = compile(files[i], out, err);
+
+    {
+      lock_guard<mutex> guard(lock);
+      results[i].status = status;
+      results[i].out.swap(out);
+      results[i].err.swap(err);
+      results[i].done = true;
+    }
+    finished.notify_one();
+  }
+}
+
+int Batch::run(ostream& out, ostream& err) {
+  vector<thread> threads;
+  for (int t = 0; t < jobs; t++) {
+    threads.push_back(thread(&Batch::work, this));
+  }
+
+  // print out the results in order, releasing each one as soon as it is printed
+  const bool headers = files.size() > 1;
+  int res = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    Result r;
+    {
+      unique_lock<mutex> guard(lock);
+      finished.wait(guard, [this, i] { return results[i].done; });
+      r.status = results[i].status;
+      r.out.swap(results[i].out);
+      r.err.swap(results[i].err);
+    }
+
+    if (headers) {
+      out << "==> " << files[i] << " <==\n";
+    }
+    out << r.out;
+    if (!r.err.empty()) {
+      out.flush();
+      if (headers) {
+        err << "==> " << files[i] << " <==\n";
+      }
+      err << r.err;
+      err.flush();
+    }
+    if (r.status != 0) {
+      res = 1;
+    }
+  }
+
+  for (size_t t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+  out.flush();
+  return res;
+}
@@ -0,0 +1,72 @@
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+/**
+ * @file batch.hpp
+ * @brief This header file contains the batch driver, which compiles
+ * many programs at once on a pool of threads.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "context.hpp"
+#include "cache.hpp"
+
+/** Compiles a list of programs on a pool of threads, each program in its
+ *  own CompilerContext.
+ *
+ *  The threads take the next program to compile from a shared counter, and
+ *  keep what it prints (on both streams) in memory; the results are then
+ *  printed out in the order in which the programs were given, as soon as
+ *  all the programs before them are done. Hence, the output does not depend
+ *  on the number of threads, nor on their timing (apart from the
+ *  statistics that report times).
+ */
+class Batch {
+private:
+  /* The outcome of the compilation of one program */
+  struct Result {
+    bool done = false;
+    int status = 0;
+    std::string out;
+    std::string err;
+  };
+
+  const std::vector<std::string>& files;
+  const Options& opt;
+  int jobs;
+  Cache* cache;
+
+  std::vector<Result> results;
+  std::size_t next;
+  std::mutex lock;
+  std::condition_variable finished;
+
+  void work();
+  int compile(const std::string& file, std::string& out, std::string& err);
+
+  // Stop the compiler from generating methods of copy the object
+  Batch(Batch const& copy);            // Not to be implemented
+  Batch& operator=(Batch const& copy); // Not to be implemented
+public:
+  /** Constructor.
+   *  @param files The paths of the programs to compile
+   *  @param opt What to do with each program
+   *  @param jobs The number of threads compiling the programs (at least 1)
+   *  @param cache Where to look for programs compiled before (NULL for none)
+   */
+  Batch(const std::vector<std::string>& files, const Options& opt, int jobs, Cache* cache);
+
+  /** Compiles all the programs. What each of them prints is printed out
+   *  on out and err; when there are several programs, after a header naming
+   *  each one (a single program prints out exactly what it would alone, e.g.
+   *  an image with --emit=image).
+   *  Returns 0 if all the programs were compiled (and run) successfully.
+   */
+  int run(std::ostream& out, std::ostream& err);
+};
+
+#endif //BATCH_HPP_
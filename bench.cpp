@@ -0,0 +1,397 @@
+/**
+ * @file bench.cpp
+ * @brief The benchmark driver run by "make bench".
+ *
+ * It generates synthetic programs of a given shape (see Workload), times
+ * each phase of tinycomp on them, and appends one JSON record per workload
+ * and phase to a file, so that the results of different commits can be
+ * compared. It runs the tinycomp binary in the current directory, as a
+ * user would, so each time includes the start-up of a process (which is
+ * measured on its own, as the "startup" phase).
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+extern char** environ;
+
+/** The shape of a synthetic program.
+ *
+ *  A program declares decls variables, whose types follow the mix (all int,
+ *  all float, all fraction, or the three in turn), and then has stmts
+ *  statements: assignments of arithmetic expressions of a single type
+ *  (division is only by non-zero constants, so that the program never
+ *  fails), if statements on chains of || and while loops, nested up to
+ *  depth levels. Every loop runs ITERATIONS times, counting on its own int
+ *  variables (the language has no '<', so a loop runs until a flag is set).
+ *  The same seed gives the same program.
+ */
+class Workload {
+private:
+  int decls;
+  int stmts;
+  int depth;
+  string mix;
+  unsigned seed;
+
+  mt19937 rng;
+  vector<string> vars[3];
+
+  static const int ITERATIONS = 3;
+
+  int pick(int n) { return uniform_int_distribution<int>(0, n - 1)(rng); }
+  string constant(int t);
+  string expr(int t);
+  string cond();
+  void block(ostream& out, int count, int level, const string& indent);
+public:
+  /** The types of the variables, as indices of vars */
+  enum { INT, FLOAT, FRACTION };
+
+  /** Constructor; returns a workload with stmts = 0 if spec is not DECLS:STMTS:DEPTH:MIX */
+  Workload(const string& spec, unsigned seed);
+
+  /** Returns true if the workload was well specified */
+  bool valid() const;
+
+  /** Returns a name for the workload, such as "mixed-d100-s2000-n2" */
+  string getName() const;
+
+  /** Prints out the program */
+  void generate(ostream& out);
+
+  /** Prints out the shape of the workload, as JSON fields */
+  void printFields(ostream& out) const;
+};
+
+Workload::Workload(const string& spec, unsigned seed) : decls(0), stmts(0), depth(0), seed(seed) {
+  char name[32];
+  if (sscanf(spec.c_str(), "%d:%d:%d:%31s", &decls, &stmts, &depth, name) != 4) {
+    stmts = 0;
+    return;
+  }
+  mix = name;
+}
+
+bool Workload::valid() const {
+  return decls > 0 && stmts > 0 && depth >= 0
+    && (mix == "int" || mix == "float" || mix == "fraction" || mix == "mixed");
+}
+
+string Workload::getName() const {
+  return mix + "-d" + to_string(decls) + "-s" + to_string(stmts) + "-n" + to_string(depth);
+}
+
+void Workload::printFields(ostream& out) const {
+  out << "\"workload\":\"" << getName() << "\",\"decls\":" << decls << ",\"stmts\":" << stmts
+      << ",\"depth\":" << depth << ",\"mix\":\"" << mix << "\"";
+}
+
+/** Returns a constant of type t (never zero, so that it can be a divisor) */
+string Workload::constant(int t) {
+  switch (t) {
+  case INT:
+    return to_string(1 + pick(9));
+  case FLOAT:
+    return to_string(1 + pick(9)) + "." + to_string(pick(10));
+  default:
+    return to_string(1 + pick(9)) + "|" + to_string(1 + pick(9));
+  }
+}
+
+/** Returns an expression of type t, of one to four terms */
+string Workload::expr(int t) {
+  static const char* const ops[] = { " + ", " * ", " / " };
+  string e;
+  const int terms = 1 + pick(4);
+
+  bool divisor = false;
+  for (int k = 0; k < terms; k++) {
+    if (k > 0) {
+      const int op = pick(3);
+      e += ops[op];
+      divisor = op == 2;
+    }
+    // a variable is never a divisor
+    if (!divisor && pick(3) > 0) {
+      e += vars[t][pick(vars[t].size())];
+    } else {
+      e += constant(t);
+    }
+  }
+  return e;
+}
+
+/** Returns a chain of one to four equalities, joined by || */
+string Workload::cond() {
+  string c;
+  const int terms = 1 + pick(4);
+
+  for (int k = 0; k < terms; k++) {
+    int t;
+    do {
+      t = pick(3);
+    } while (vars[t].empty());
+
+    if (k > 0) {
+      c += " || ";
+    }
+    // the lax == turns fractions into ints, which fails once a denominator overflows to 0
+    const bool lax = t != FRACTION && pick(2);
+    c += vars[t][pick(vars[t].size())] + (lax ? " == " : " = ") + constant(t);
+  }
+  return c;
+}
+
+/** Prints out count statements, with loops and ifs nested below level */
+void Workload::block(ostream& out, int count, int level, const string& indent) {
+  while (count > 0) {
+    const int kind = level < depth ? pick(10) : 9;
+    const int body = 1 + pick(min(count, 8));
+
+    if (kind == 0 && count > 1) {
+      // a loop runs its body ITERATIONS times
+      const string done = "k" + to_string(level), n = "n" + to_string(level);
+      out << indent << done << " := 0;\n" << indent << n << " := 0;\n";
+      out << indent << "while (" << done << " == 0) {\n";
+      block(out, body, level + 1, indent + "  ");
+      out << indent << "  " << n << " := " << n << " + 1;\n";
+      out << indent << "  if (" << n << " == " << ITERATIONS << ") then {\n";
+      out << indent << "    " << done << " := 1;\n";
+      out << indent << "  };\n";
+      out << indent << "};\n";
+      count -= body;
+    } else if (kind == 1 && count > 1) {
+      out << indent << "if (" << cond() << ") then {\n";
+      block(out, body, level + 1, indent + "  ");
+      out << indent << "};\n";
+      count -= body;
+    } else {
+      int t;
+      do {
+        t = pick(3);
+      } while (vars[t].empty());
+
+      out << indent << vars[t][pick(vars[t].size())] << " := " << expr(t) << ";\n";
+      count--;
+    }
+  }
+}
+
+void Workload::generate(ostream& out) {
+  static const char* const typeNames[] = { "int", "float", "fraction" };
+
+  rng.seed(seed);
+  for (int t = 0; t < 3; t++) {
+    vars[t].clear();
+  }
+
+  for (int k = 0; k < decls; k++) {
+    int t = mix == "int" ? INT : mix == "float" ? FLOAT : mix == "fraction" ? FRACTION : k % 3;
+    vars[t].push_back(string(1, "ifq"[t]) + to_string(k));
+  }
+
+  // the counters and flags of the loops (one pair per level) are not used by expressions
+  out << "int";
+  for (int l = 0; l < depth; l++) {
+    out << (l > 0 ? ", " : " ") << "k" << l << ", n" << l;
+  }
+  if (depth == 0) {
+    out << " k0";
+  }
+  out << ";\n";
+
+  for (int t = 0; t < 3; t++) {
+    if (!vars[t].empty()) {
+      out << typeNames[t];
+      for (size_t k = 0; k < vars[t].size(); k++) {
+        out << (k > 0 ? ", " : " ") << vars[t][k];
+      }
+      out << ";\n";
+    }
+  }
+
+  // every variable starts from a constant
+  for (int t = 0; t < 3; t++) {
+    for (size_t k = 0; k < vars[t].size(); k++) {
+      out << vars[t][k] << " := " << constant(t) << ";\n";
+    }
+  }
+
+  block(out, stmts, 0, "");
+}
+
+/** Runs ./tinycomp with the given arguments, reading in and writing out
+ *  (NULL for /dev/null). Returns its exit status, or -1 if it could not run.
+ */
+static int spawn(const vector<string>& args, const char* in, const char* out) {
+  vector<char*> argv;
+  argv.push_back((char*)"./tinycomp");
+  for (size_t k = 0; k < args.size(); k++) {
+    argv.push_back((char*)args[k].c_str());
+  }
+  argv.push_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 0, in != nullptr ? in : "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, 1, out != nullptr ? out : "/dev/null",
+                                   O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+  pid_t pid;
+  int status = -1;
+  if (posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0) {
+    waitpid(pid, &status, 0);
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  return status;
+}
+
+/** Runs tinycomp runs times, and returns the shortest wall time (in seconds) */
+static double measure(int runs, const vector<string>& args, const char* in, const char* out, int& status) {
+  double best = 0;
+  for (int r = 0; r < runs; r++) {
+    auto start = chrono::steady_clock::now();
+    status = spawn(args, in, out);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (r == 0 || secs < best) {
+      best = secs;
+    }
+  }
+  return best;
+}
+
+static void usage(const char* name) {
+  cerr << "Usage: " << name << " [-c COMMIT] [-o FILE] [-r RUNS] [-s SEED] DECLS:STMTS:DEPTH:MIX..." << endl;
+  cerr << "       " << name << " --generate [-s SEED] DECLS:STMTS:DEPTH:MIX" << endl;
+  cerr << "  MIX is the type of the variables: int, float, fraction or mixed" << endl;
+  cerr << "  -c COMMIT   the commit recorded with the results" << endl;
+  cerr << "  -o FILE     append the results to FILE, one JSON record per line (default: stdout)" << endl;
+  cerr << "  -r RUNS     run each phase RUNS times, and keep the fastest (default: 3)" << endl;
+  cerr << "  --generate  only print out the program" << endl;
+}
+
+int main(int argc, char** argv) {
+  string commit = "unknown";
+  string output;
+  int runs = 3;
+  unsigned seed = 1;
+  bool generateOnly = false;
+  vector<string> specs;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      commit = argv[++i];
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+      runs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--generate") == 0) {
+      generateOnly = true;
+    } else if (argv[i][0] != '-') {
+      specs.push_back(argv[i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (specs.empty() || (generateOnly && specs.size() != 1)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (generateOnly) {
+    Workload w(specs[0], seed);
+    if (!w.valid()) {
+      usage(argv[0]);
+      return 2;
+    }
+    w.generate(cout);
+    return 0;
+  }
+
+  ofstream file;
+  if (!output.empty()) {
+    file.open(output.c_str(), ios::app);
+    if (!file) {
+      cerr << "Can not open " << output << endl;
+      return 1;
+    }
+  }
+  ostream& records = output.empty() ? cout : file;
+
+  const string source = "bench.tc", image = "bench.tci";
+  const long stamp = (long)time(nullptr);
+
+  // each phase: its name, the arguments of tinycomp, and where its output goes
+  struct Phase {
+    const char* name;
+    vector<string> args;
+    const char* out;
+  };
+  const Phase phases[] = {
+    { "lex", { "--lex" }, nullptr },
+    { "compile", { "--emit=image" }, image.c_str() },
+    { "run", { "--load=" + image }, nullptr },
+    { "total", { "--run" }, nullptr },
+  };
+
+  // the start-up of a process, which the other phases include
+  int status;
+  double startup = measure(runs, { "--lex" }, nullptr, nullptr, status);
+  records << "{\"commit\":\"" << commit << "\",\"time\":" << stamp
+          << ",\"phase\":\"startup\",\"seconds\":" << startup << ",\"status\":" << status << "}" << endl;
+
+  int res = 0;
+  for (size_t k = 0; k < specs.size(); k++) {
+    Workload w(specs[k], seed);
+    if (!w.valid()) {
+      cerr << "Bad workload " << specs[k] << endl;
+      res = 1;
+      continue;
+    }
+
+    {
+      ofstream program(source.c_str());
+      w.generate(program);
+    }
+    ifstream in(source.c_str(), ios::ate | ios::binary);
+    const long bytes = (long)in.tellg();
+
+    for (size_t p = 0; p < sizeof(phases) / sizeof(phases[0]); p++) {
+      double secs = measure(runs, phases[p].args, source.c_str(), phases[p].out, status);
+
+      records << "{\"commit\":\"" << commit << "\",\"time\":" << stamp << ",";
+      w.printFields(records);
+      records << ",\"bytes\":" << bytes << ",\"phase\":\"" << phases[p].name
+              << "\",\"seconds\":" << secs << ",\"status\":" << status << "}" << endl;
+      if (status != 0) {
+        cerr << w.getName() << ": tinycomp " << phases[p].args[0] << " exited with status " << status << endl;
+        res = 1;
+      }
+    }
+    cerr << w.getName() << " done" << endl;
+  }
+
+  remove(source.c_str());
+  remove(image.c_str());
+  return res;
+}
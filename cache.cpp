@@ -0,0 +1,335 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "cache.hpp"
+#include "image.hpp"
+
+Cache::Cache(const string& dir) : dir(dir), hits(0), misses(0), stores(0), resumed(0), reused(0), saved(0) {
+  mkdir(dir.c_str(), 0777);
+}
+
+bool Cache::cacheable(const Options& opt) {
+  return !opt.run && !opt.jit && !opt.profile && !opt.lexOnly && !opt.stats;
+}
+
+bool Cache::runnable(const Options& opt) {
+  return opt.run && !opt.jit && !opt.emitC && !opt.emitImage && !opt.profile && !opt.lexOnly && !opt.stats;
+}
+
+/** FNV-1a hash of n bytes, continuing from h */
+static uint64_t fnv1a(uint64_t h, const char* s, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+  }
+  return h;
+}
+
+uint64_t Cache::key(const SourceBuffer& src, const Options& opt) {
+  // the version and options come first, each followed by a NUL (which they can not contain)
+  const string prefix = to_string(VERSION) + '\0' + opt.flags() + '\0';
+
+  uint64_t h = fnv1a(14695981039346656037ull, prefix.data(), prefix.size());
+  return fnv1a(h, src.getBase(), src.getSize());
+}
+
+/** Returns the length of the declarations at the beginning of the program
+ *  in s, as far as they can be told apart without parsing it: up to the end
+ *  of the last line that begins with a type name, before the first line that
+ *  does not (blank lines and comments aside).
+ */
+static size_t declarations(const char* s, size_t n) {
+  static const char* const types[] = { "int", "float", "fraction" };
+
+  size_t end = 0;
+  for (size_t i = 0; i < n; ) {
+    size_t eol = i;
+    while (eol < n && s[eol] != '\n') {
+      eol++;
+    }
+
+    size_t first = i;
+    while (first < eol && (s[first] == ' ' || s[first] == '\t' || s[first] == '\r')) {
+      first++;
+    }
+    size_t word = first;
+    while (word < eol && (isalnum((unsigned char)s[word]) || s[word] == '_')) {
+      word++;
+    }
+
+    bool type = false;
+    for (const char* t : types) {
+      type = type || (word - first == strlen(t) && memcmp(s + first, t, word - first) == 0);
+    }
+    if (type) {
+      end = eol;
+    } else if (first < eol && !(eol - first >= 2 && s[first] == '/' && s[first + 1] == '/')) {
+      break;
+    }
+    i = eol + 1;
+  }
+  return end;
+}
+
+uint64_t Cache::prefixKey(const SourceBuffer& src, const Options& opt) {
+  // the checkpoints of a parse depend on --canonical alone (see Emitter::setCanonical())
+  const string prefix = to_string(VERSION) + '\0' + "checkpoints" + (opt.canonical ? " --canonical" : "") + '\0';
+
+  uint64_t h = fnv1a(14695981039346656037ull, prefix.data(), prefix.size());
+  return fnv1a(h, src.getBase(), declarations(src.getBase(), src.getSize()));
+}
+
+string Cache::path(uint64_t key) const {
+  char name[17];
+  snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+  return dir + "/" + name;
+}
+
+/** Reads the whole file into data. Returns false if it can not be read */
+static bool readFile(const string& file, string& data) {
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  // entries are small: read them whole, with as few calls as possible
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0;
+  if (ok) {
+    data.resize(st.st_size);
+    size_t done = 0;
+    while (done < data.size()) {
+      ssize_t k = read(fd, &data[done], data.size() - done);
+      if (k <= 0) {
+        break;
+      }
+      done += k;
+    }
+    ok = done == data.size();
+  }
+  close(fd);
+  return ok;
+}
+
+/** Writes data to the file, replacing it at once. Returns false if it can not be written */
+bool Cache::writeFile(const string& file, const string& data) {
+  string tmp = dir + "/.tmpXXXXXX";
+  int fd = mkstemp(&tmp[0]);
+  if (fd < 0) {
+    // the cache is only an optimization: not being able to fill it is no error
+    return false;
+  }
+
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t k = write(fd, data.data() + done, data.size() - done);
+    if (k <= 0) {
+      break;
+    }
+    done += k;
+  }
+  close(fd);
+
+  if (done < data.size() || rename(tmp.c_str(), file.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+/** Reads an entry. Returns false if there is none for this source and options */
+bool Cache::load(uint64_t key, const SourceBuffer& src, const string& flags,
+                 int& status, string& out, string& err, double& secs) {
+  string data;
+  const string header = "tinycomp-cache " + to_string(VERSION) + '\n' + flags + '\n';
+  if (!readFile(path(key), data) || data.compare(0, header.size(), header) != 0) {
+    return false;
+  }
+
+  size_t size, outSize, errSize;
+  int used;
+  // (a '\n' in the format would also skip the blanks the program begins with)
+  if (sscanf(data.c_str() + header.size(), "%zu %d %zu %zu %lf%n",
+             &size, &status, &outSize, &errSize, &secs, &used) != 5
+      || data[header.size() + used++] != '\n'
+      || size != src.getSize()
+      || outSize > data.size() || errSize > data.size()
+      || header.size() + used + size + outSize + errSize != data.size()
+      || data.compare(header.size() + used, size, src.getBase(), size) != 0) {
+    // another program with the same hash (or a damaged entry): a miss
+    return false;
+  }
+
+  const size_t start = header.size() + used + size;
+  out.assign(data, start, outSize);
+  err.assign(data, start + outSize, errSize);
+  return true;
+}
+
+/** Writes an entry, replacing the one for the same key (if any) at once */
+void Cache::store(uint64_t key, const SourceBuffer& src, const string& flags,
+                  int status, const string& out, const string& err, double secs) {
+  ostringstream entry;
+  entry << "tinycomp-cache " << VERSION << '\n' << flags << '\n'
+        << src.getSize() << ' ' << status << ' ' << out.size() << ' ' << err.size() << ' ' << secs << '\n';
+  entry.write(src.getBase(), src.getSize());
+  entry << out << err;
+
+  if (!writeFile(path(key), entry.str())) {
+    return;
+  }
+
+  lock_guard<mutex> guard(lock);
+  stores++;
+}
+
+/** The first line of an entry holding checkpoints, followed by the options they depend on */
+static string prefixHeader(int version, const Options& opt) {
+  return "tinycomp-checkpoints " + to_string(version) + '\n' + (opt.canonical ? "--canonical" : "") + '\n';
+}
+
+/** Reads the checkpoints of the last program compiled with the same
+ *  declarations as the one in src, and picks the one to resume from.
+ *  Returns false if there is none (the checkpoints are left empty then).
+ */
+bool Cache::loadPrefix(uint64_t key, const SourceBuffer& src, const Options& opt, Checkpoints& checkpoints) {
+  string data;
+  if (!readFile(path(key), data)) {
+    return false;
+  }
+
+  // the program stored comes first, after its size
+  const string header = prefixHeader(VERSION, opt);
+  size_t size;
+  int used;
+  if (data.compare(0, header.size(), header) != 0
+      || sscanf(data.c_str() + header.size(), "%zu%n", &size, &used) != 1
+      || data[header.size() + used++] != '\n'
+      || size > data.size() - header.size() - used) {
+    return false;
+  }
+  const char* stored = data.data() + header.size() + used;
+
+  // the statements the parse resumes after must be in the part both programs have in common
+  const size_t n = min(size, src.getSize());
+  const size_t common = mismatch(stored, stored + n, src.getBase()).first - stored;
+
+  return checkpoints.load(data, header.size() + used + size, common);
+}
+
+/** Writes the checkpoints of the program in src, in place of the last ones with the same key */
+void Cache::storePrefix(uint64_t key, const SourceBuffer& src, const Options& opt, const Checkpoints& checkpoints) {
+  string data = prefixHeader(VERSION, opt) + to_string(src.getSize()) + '\n';
+  data.append(src.getBase(), src.getSize());
+  checkpoints.save(data);
+
+  writeFile(path(key), data);
+}
+
+/** Returns what compiling the program in src with the cacheable options opt
+ *  prints out, from the cache if possible, or else by calling build (from the
+ *  checkpoints of another program, if it shares some statements with it).
+ */
+int Cache::lookup(const SourceBuffer& src, const Options& opt, const Build& build,
+                  string& out, string& err) {
+  auto start = chrono::steady_clock::now();
+  const uint64_t k = key(src, opt);
+  const string flags = opt.flags();
+
+  int status;
+  double secs;
+  if (load(k, src, flags, status, out, err, secs)) {
+    double spent = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    lock_guard<mutex> guard(lock);
+    hits++;
+    if (secs > spent) {
+      saved += secs - spent;
+    }
+    return status;
+  }
+
+  {
+    lock_guard<mutex> guard(lock);
+    misses++;
+  }
+
+  start = chrono::steady_clock::now();
+  const uint64_t pk = prefixKey(src, opt);
+  Checkpoints checkpoints(src);
+  const bool resume = loadPrefix(pk, src, opt, checkpoints);
+  status = build(opt, &checkpoints, out, err);
+  secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  store(k, src, flags, status, out, err, secs);
+  if (status == 0 && checkpoints.complete()) {
+    storePrefix(pk, src, opt, checkpoints);
+  }
+
+  if (resume) {
+    lock_guard<mutex> guard(lock);
+    resumed++;
+    reused += checkpoints.getReused();
+  }
+  return status;
+}
+
+int Cache::compile(const SourceBuffer& src, const Options& opt, const Build& build,
+                   string& out, string& err) {
+  if (src.getBase() == nullptr || (!cacheable(opt) && !runnable(opt))) {
+    return build(opt, nullptr, out, err);
+  }
+  if (cacheable(opt)) {
+    return lookup(src, opt, build, out, err);
+  }
+
+  // the program is run from its image, cached as --emit=image prints it
+  Options emit = opt;
+  emit.run = false;
+  emit.emitImage = true;
+
+  string data, errors;
+  int status = lookup(src, emit, build, data, errors);
+  if (status != 0) {
+    // the program could not be compiled
+    out.clear();
+    err = errors;
+    return status;
+  }
+
+  Image image;
+  ostringstream printed, errs;
+  if (!image.use(&data[0], data.size(), errs)) {
+    // e.g. not aligned as an image: the program is compiled and run as usual
+    return build(opt, nullptr, out, err);
+  }
+  {
+    OutBuf buf(printed);
+    status = image.run(buf, errs);
+  }
+  out = printed.str();
+  err = errors + errs.str();
+  return status;
+}
+
+void Cache::printOut(ostream& out) {
+  lock_guard<mutex> guard(lock);
+
+  const long lookups = hits + misses;
+  out << "Cache: " << hits << " hits, " << misses << " misses";
+  if (lookups > 0) {
+    out << " (" << 100.0 * hits / lookups << "% hit rate)";
+  }
+  out << ", " << resumed << " resumed (" << reused << " statements reused), "
+      << stores << " stored, " << saved << " s saved" << endl;
+}
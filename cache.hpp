@@ -0,0 +1,111 @@
+#ifndef CACHE_HPP_
+#define CACHE_HPP_
+
+/**
+ * @file cache.hpp
+ * @brief This header file contains the compilation cache, which keeps
+ * on disk what the compiler printed out for each program it compiled.
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <functional>
+#include <mutex>
+#include "context.hpp"
+
+/** An on-disk cache of compilations, keyed by the contents of the program
+ *  and the options it was compiled with.
+ *
+ *  Each entry is a file in the cache directory, named after a 64-bit
+ *  FNV-1a hash of the options and the source, holding what the compiler
+ *  printed out (on both streams) and its status; a hit returns them as
+ *  they were, without lexing or parsing the program again. The entry also
+ *  holds the options and the source itself, which are compared with those
+ *  of the program on a hit (two programs may have the same hash), and how
+ *  long the compilation took, to report the time saved.
+ *
+ *  A program run with --run is not cached as such (what it prints includes
+ *  times): its image is, as --emit=image prints it, and the program is run
+ *  from there as --load runs an image (see Image::use()), without being
+ *  compiled again.
+ *
+ *  On a miss, the program is compiled from the checkpoints of the last
+ *  program compiled with the same declarations (see Checkpoints), kept in
+ *  an entry of their own, named after the declarations alone: the
+ *  statements both programs begin with are not parsed again. The
+ *  checkpoints of the program are then stored in their place.
+ *
+ *  Entries are written to a temporary file and then renamed, so several
+ *  threads (or processes) can share a cache directory, and a reader never
+ *  sees half an entry. Only the options whose output depends on the
+ *  program alone are cached (see cacheable() and runnable()); the others
+ *  are always compiled.
+ */
+class Cache {
+public:
+  /** Compiles a program with the given options, recording its checkpoints
+   *  (or resuming from one of them) when they are not NULL; what the
+   *  compiler prints goes in the two strings, and the status is returned.
+   */
+  typedef std::function<int(const Options&, Checkpoints*, std::string&, std::string&)> Build;
+
+private:
+  std::string dir;
+
+  std::mutex lock;
+  long hits;
+  long misses;
+  long stores;
+  long resumed;
+  long reused;
+  double saved;
+
+  std::string path(std::uint64_t key) const;
+  static std::uint64_t prefixKey(const SourceBuffer& src, const Options& opt);
+  bool load(std::uint64_t key, const SourceBuffer& src, const std::string& flags,
+            int& status, std::string& out, std::string& err, double& secs);
+  void store(std::uint64_t key, const SourceBuffer& src, const std::string& flags,
+             int status, const std::string& out, const std::string& err, double secs);
+  bool loadPrefix(std::uint64_t key, const SourceBuffer& src, const Options& opt, Checkpoints& checkpoints);
+  void storePrefix(std::uint64_t key, const SourceBuffer& src, const Options& opt, const Checkpoints& checkpoints);
+  bool writeFile(const std::string& file, const std::string& data);
+  int lookup(const SourceBuffer& src, const Options& opt, const Build& build,
+             std::string& out, std::string& err);
+
+  // Stop the compiler from generating methods of copy the object
+  Cache(Cache const& copy);            // Not to be implemented
+  Cache& operator=(Cache const& copy); // Not to be implemented
+public:
+  /** Bumped whenever the output of the compiler changes, to leave the old entries behind */
+  static const int VERSION = 2;
+
+  /** Constructor, for the cache in the directory dir (created if missing) */
+  Cache(const std::string& dir);
+
+  /** Returns true if the output of a compilation with opt can be cached:
+   *  not when the program is run, nor with --lex or --stats, which all report times.
+   */
+  static bool cacheable(const Options& opt);
+
+  /** Returns true if a program run with opt can be run from its cached
+   *  image: only with --run (and --canonical), as the Interpreter runs it.
+   */
+  static bool runnable(const Options& opt);
+
+  /** Returns the key of the program in src compiled with opt */
+  static std::uint64_t key(const SourceBuffer& src, const Options& opt);
+
+  /** Returns what compiling the program in src with opt prints out (in out
+   *  and err) and its status, from the cache if possible. Otherwise, build
+   *  is called to compile the program, and its output is stored.
+   *  A program not in memory (e.g. read from a pipe) is always compiled.
+   */
+  int compile(const SourceBuffer& src, const Options& opt, const Build& build,
+              std::string& out, std::string& err);
+
+  /** Prints out the hit rate, the statements reused and the time saved so far */
+  void printOut(std::ostream& out);
+};
+
+#endif //CACHE_HPP_
@@ -0,0 +1,183 @@
+#include <iostream>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "cfg.hpp"
+
+FlowGraph::FlowGraph(TargetCode* code) : code(code), blocks(0), threaded(0), unreachable(0), removed(0) {
+}
+
+/** Returns the destination of instruction i, if it is a jump that has been backpatched, or -1 */
+int FlowGraph::target(int i) const {
+  const TacInstr& instr = code->getInstr(i);
+  const oprEnum op = instr.getOp();
+
+  if (op != jmpOpr && op != jeOpr && op != condJmpOpr) {
+    return -1;
+  }
+  int dest = instr.getDest();
+  return (dest < code->getNextInstr()) ? dest : -1;
+}
+
+/** Follows the chain of unconditional jumps starting at dest, and returns where it ends */
+int FlowGraph::thread(int dest) const {
+  const int n = code->getNextInstr();
+
+  // a chain longer than the code is a loop made of jumps only: any of them will do
+  for (int steps = 0; steps < n; steps++) {
+    if (code->getInstr(dest).getOp() != jmpOpr || target(dest) < 0) {
+      break;
+    }
+    dest = target(dest);
+  }
+  return dest;
+}
+
+/** Splits the code into basic blocks, and links each block to its successors */
+void FlowGraph::build() {
+  const int n = code->getNextInstr();
+
+  vector<bool> leader;
+  code->findLeaders(leader);
+
+  starts.clear();
+  vector<int> blockOf(n);
+  for (int i = 0; i < n; i++) {
+    if (leader[i]) {
+      starts.push_back(i);
+    }
+    blockOf[i] = starts.size() - 1;
+  }
+  starts.push_back(n);
+  blocks = starts.size() - 1;
+
+  succ1.assign(blocks, -1);
+  succ2.assign(blocks, -1);
+  for (int b = 0; b < blocks; b++) {
+    const int last = starts[b+1] - 1;
+    const int dest = target(last);
+
+    switch (code->getInstr(last).getOp()) {
+    case haltOpr:
+      break;
+    case jmpOpr:
+      if (dest >= 0) succ1[b] = blockOf[dest];
+      break;
+    case jeOpr:
+    case condJmpOpr:
+      if (dest >= 0) succ1[b] = blockOf[dest];
+      if (b + 1 < blocks) succ2[b] = b + 1;
+      break;
+    default:
+      if (b + 1 < blocks) succ1[b] = b + 1;
+      break;
+    }
+  }
+}
+
+/** Marks the blocks that can be reached from the first one */
+void FlowGraph::reach(vector<bool>& live) const {
+  live.assign(blocks, false);
+
+  vector<int> work(1, 0);
+  live[0] = true;
+  while (!work.empty()) {
+    int b = work.back();
+    work.pop_back();
+
+    int next[2] = { succ1[b], succ2[b] };
+    for (int k = 0; k < 2; k++) {
+      if (next[k] >= 0 && !live[next[k]]) {
+        live[next[k]] = true;
+        work.push_back(next[k]);
+      }
+    }
+  }
+}
+
+int FlowGraph::run() {
+  const int n = code->getNextInstr();
+
+  blocks = threaded = unreachable = removed = 0;
+  starts.clear();
+
+  if (n == 0) {
+    return 0;
+  }
+
+  // jumps to an unconditional jump go straight to the end of the chain
+  for (int i = 0; i < n; i++) {
+    int dest = target(i);
+    if (dest < 0) {
+      continue;
+    }
+    int last = thread(dest);
+    if (last != dest) {
+      code->getInstr(i).patch(last);
+      threaded++;
+    }
+  }
+
+  build();
+
+  vector<bool> live;
+  reach(live);
+
+  vector<bool> dead(n, false);
+  for (int b = 0; b < blocks; b++) {
+    if (live[b]) {
+      continue;
+    }
+    unreachable++;
+    for (int i = starts[b]; i < starts[b+1]; i++) {
+      dead[i] = true;
+    }
+  }
+
+  // a jump to the instruction that follows it (once the dead ones are gone)
+  // is useless, since evaluating a condition has no side effects
+  int next = n;
+  for (int i = n - 1; i >= 0; i--) {
+    if (dead[i]) {
+      continue;
+    }
+    const oprEnum op = code->getInstr(i).getOp();
+    if ((op == jmpOpr || op == jeOpr) && target(i) == next) {
+      dead[i] = true;
+    } else {
+      next = i;
+    }
+  }
+
+  // an instruction kept must not refer to the value of one that is gone
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < n; i++) {
+      if (dead[i]) {
+        continue;
+      }
+      const TacInstr& instr = code->getInstr(i);
+      Operand o[3] = { instr.getOperand1(), instr.getOperand2(), instr.getTemp() };
+      for (int k = 0; k < 3; k++) {
+        if (k == 2 && target(i) >= 0) {
+          continue;
+        }
+        if (o[k].kind == instrOpd && dead[o[k].val.i]) {
+          dead[o[k].val.i] = false;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  removed = code->remove(dead);
+  return removed;
+}
+
+void FlowGraph::printOut(OutBuf& out) const {
+  out << blocks << " blocks (" << unreachable << " unreachable), "
+      << threaded << " jumps threaded, " << removed << " instructions removed\n";
+}
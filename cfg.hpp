@@ -0,0 +1,56 @@
+#ifndef CFG_HPP_
+#define CFG_HPP_
+
+/**
+ * @file cfg.hpp
+ * @brief This header file contains the control-flow graph of the 3-addr
+ * code, and the pass that simplifies the jumps it is made of.
+ */
+
+#include <vector>
+#include "tinycomp.hpp"
+
+/** The control-flow graph of a TargetCode, used to clean up the jumps left
+ *  by the translation of while, || and the backpatching of statement lists.
+ *
+ *  The code is split into basic blocks. Every jump to an unconditional jump
+ *  is threaded to the end of the chain; then the blocks that can not be
+ *  reached from the first one are removed, as well as the jumps to the
+ *  instruction that would be executed next anyway. The remaining
+ *  instructions are renumbered, and the jumps patched accordingly.
+ */
+class FlowGraph {
+private:
+  TargetCode* code;
+
+  /* the first instruction of each block, followed by the size of the code */
+  std::vector<int> starts;
+  /* the successors of each block (-1 if none) */
+  std::vector<int> succ1, succ2;
+
+  int blocks;
+  int threaded;
+  int unreachable;
+  int removed;
+
+  int target(int i) const;
+  int thread(int dest) const;
+  void build();
+  void reach(std::vector<bool>& live) const;
+public:
+  /** Constructor; binds the graph to the code it simplifies */
+  FlowGraph(TargetCode* code);
+
+  /** Builds the graph and simplifies the code.
+   *  Returns the number of instructions removed.
+   */
+  int run();
+
+  /** Returns the number of instructions removed by the last run() */
+  int getRemoved() const { return removed; }
+
+  /** Prints out the blocks found and what was simplified */
+  void printOut(OutBuf& out) const;
+};
+
+#endif //CFG_HPP_
@@ -0,0 +1,315 @@
+#include <cmath>
+#include <cstring>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "cgen.hpp"
+
+/* The runtime support of the generated program.
+ * Memory is only accessed through memcpy, which gcc turns into plain moves
+ * while keeping clear of the strict aliasing rules.
+ */
+static const char* prelude =
+  "#include <stdio.h>\n"
+  "#include <stdint.h>\n"
+  "#include <string.h>\n"
+  "\n"
+  "typedef struct { int32_t num, denom; } Fraction;\n"
+  "\n"
+  "static inline int32_t ldi(int o) { int32_t v; memcpy(&v, mem + o, 4); return v; }\n"
+  "static inline float ldf(int o) { float v; memcpy(&v, mem + o, 4); return v; }\n"
+  "static inline Fraction ldq(int o) { Fraction v; memcpy(&v, mem + o, 8); return v; }\n"
+  "static inline void sti(int o, int32_t v) { memcpy(mem + o, &v, 4); }\n"
+  "static inline void stf(int o, float v) { memcpy(mem + o, &v, 4); }\n"
+  "static inline void stq(int o, Fraction v) { memcpy(mem + o, &v, 8); }\n"
+  "static inline float f32(uint32_t bits) { float v; memcpy(&v, &bits, 4); return v; }\n"
+  "\n"
+  "/* ints wrap around on overflow; fractions are only reduced when canonical is set */\n"
+  "static inline int32_t wadd(int32_t x, int32_t y) { return (int32_t)((uint32_t)x + (uint32_t)y); }\n"
+  "static inline int32_t wmul(int32_t x, int32_t y) { return (int32_t)((uint32_t)x * (uint32_t)y); }\n"
+  "/* a NaN or a float out of the range of an int converts to INT32_MIN */\n"
+  "static inline int32_t f2i(float f) { return f >= -2147483648.0f && f < 2147483648.0f ? (int32_t)f : INT32_MIN; }\n"
+  "static inline uint32_t gcd(uint32_t u, uint32_t v) {\n"
+  "  if (u == 0 || v == 0) return u | v;\n"
+  "  int shift = __builtin_ctz(u | v);\n"
+  "  u >>= __builtin_ctz(u);\n"
+  "  while (v != 0) { v >>= __builtin_ctz(v); uint32_t lo = u < v ? u : v, hi = u < v ? v : u; u = lo; v = hi - lo; }\n"
+  "  return u << shift;\n"
+  "}\n"
+  "static inline Fraction reduce(Fraction x) {\n"
+  "  if (!canonical) return x;\n"
+  "  uint32_t n = x.num < 0 ? 0u - (uint32_t)x.num : (uint32_t)x.num, d = x.denom < 0 ? 0u - (uint32_t)x.denom : (uint32_t)x.denom;\n"
+  "  uint32_t g = gcd(n, d);\n"
+  "  if (g == 0) return x;\n"
+  "  Fraction r = { (int32_t)((x.num < 0) != (x.denom < 0) ? 0u - n / g : n / g), (int32_t)(d / g) }; return r;\n"
+  "}\n"
+  "static inline Fraction addq(Fraction x, Fraction y) {\n"
+  "  Fraction r = { wadd(wmul(x.num, y.denom), wmul(y.num, x.denom)), wmul(x.denom, y.denom) }; return reduce(r);\n"
+  "}\n"
+  "static inline Fraction mulq(Fraction x, Fraction y) {\n"
+  "  Fraction r = { wmul(x.num, y.num), wmul(x.denom, y.denom) }; return reduce(r);\n"
+  "}\n"
+  "static inline Fraction divq(Fraction x, Fraction y) {\n"
+  "  Fraction r = { wmul(x.num, y.denom), wmul(x.denom, y.num) }; return reduce(r);\n"
+  "}\n"
+  "\n"
+  "static inline int fail(const char* error, int vn) {\n"
+  "  fprintf(stderr, \"Runtime error: %s at instruction %d\\n\", error, vn);\n"
+  "  return 1;\n"
+  "}\n"
+  "\n";
+
+CBackend::CBackend(TargetCode* code, Memory& mem, SymTbl* sym, bool canonical)
+  : code(code), mem(mem), sym(sym), canonical(canonical) {
+}
+
+/** Returns the offset in memory of a variable, a temporary or the value of an instruction */
+int CBackend::location(const Operand& o) {
+  if (o.kind == instrOpd) {
+    return location(code->getInstr(o.val.i).getTemp());
+  }
+  assert(o.kind == varOpd || o.kind == tempOpd);
+  return o.val.i;
+}
+
+/** Prints out an int operand as a C expression */
+void CBackend::emitInt(OutBuf& out, const Operand& o) {
+  if (o.kind != constOpd) {
+    out << "ldi(" << location(o) << ")";
+  } else if (o.val.i == INT32_MIN) {
+    out << "INT32_MIN";
+  } else {
+    out << o.val.i;
+  }
+}
+
+/** Prints out an int or float operand as a C expression of type float */
+void CBackend::emitFloat(OutBuf& out, const Operand& o) {
+  if (o.type == intType) {
+    out << "(float)";
+    emitInt(out, o);
+  } else if (o.kind != constOpd) {
+    out << "ldf(" << location(o) << ")";
+  } else if (isfinite(o.val.f)) {
+    // hexadecimal literals are exact
+    out.putFloat(o.val.f, "%a");
+    out << 'f';
+  } else {
+    out << "f32(" << (unsigned int)o.val.i << "u)";
+  }
+}
+
+static bool isNumber(typeName t) {
+  return t == intType || t == floatType;
+}
+
+/** Prints out instruction i as a C statement.
+ *  Returns false if the instruction has no translation.
+ */
+bool CBackend::emitInstr(OutBuf& out, int i) {
+  const int n = code->getNextInstr();
+  const TacInstr& instr = code->getInstr(i);
+  const oprEnum op = instr.getOp();
+  Operand op1 = instr.getOperand1(), op2 = instr.getOperand2(), temp = instr.getTemp();
+
+  if ((op == jmpOpr || op == jeOpr) && (instr.getDest() < 0 || instr.getDest() >= n)) {
+    // a jump that was never backpatched
+    return false;
+  }
+
+  switch (op) {
+  case fakeOpr:
+    out << ";";
+    break;
+  case haltOpr:
+    out << "return 0;";
+    break;
+  case jmpOpr:
+    out << "goto L" << instr.getDest() << ";";
+    break;
+  case copyOpr:
+    if (op2.kind == noOpd) {
+      // "t(vn) = x": the value is just named, nothing to store
+      out << ";";
+    } else if (op1.type == fracType && op2.type == fracType) {
+      out << "stq(" << location(op1) << ", ldq(" << location(op2) << "));";
+    } else if (op1.type == intType && op2.type == intType) {
+      out << "sti(" << location(op1) << ", ";
+      emitInt(out, op2);
+      out << ");";
+    } else if (op1.type == floatType && isNumber(op2.type)) {
+      out << "stf(" << location(op1) << ", ";
+      emitFloat(out, op2);
+      out << ");";
+    } else if (op1.type == intType && op2.type == floatType) {
+      out << "sti(" << location(op1) << ", f2i(";
+      emitFloat(out, op2);
+      out << "));";
+    } else if (op1.type == intType && op2.type == fracType) {
+      out << "{ Fraction q = ldq(" << location(op2) << "); if (q.denom == 0 || (q.num == INT32_MIN && q.denom == -1)) "
+          << "return fail(\"integer division by zero or overflow\", " << i << "); sti(" << location(op1) << ", q.num / q.denom); }";
+    } else if (op1.type == fracType && op2.type == intType) {
+      out << "{ Fraction q = { ";
+      emitInt(out, op2);
+      out << ", 1 }; stq(" << location(op1) << ", q); }";
+    } else {
+      return false;
+    }
+    break;
+  case addOpr:
+  case mulOpr:
+  case divOpr: {
+    static const char* iops[] = { "wadd", "wmul" };
+    static const char* fops[] = { " + ", " * ", " / " };
+    static const char* qops[] = { "addq", "mulq", "divq" };
+    const int k = op - addOpr;
+
+    if (op1.type == intType && op2.type == intType) {
+      if (op == divOpr) {
+        out << "{ int32_t x = ";
+        emitInt(out, op1);
+        out << ", y = ";
+        emitInt(out, op2);
+        out << "; if (y == 0 || (x == INT32_MIN && y == -1)) return fail(\"integer division by zero or overflow\", "
+            << i << "); sti(" << location(temp) << ", x / y); }";
+      } else {
+        out << "sti(" << location(temp) << ", " << iops[k] << "(";
+        emitInt(out, op1);
+        out << ", ";
+        emitInt(out, op2);
+        out << "));";
+      }
+    } else if (isNumber(op1.type) && isNumber(op2.type)) {
+      out << "stf(" << location(temp) << ", ";
+      emitFloat(out, op1);
+      out << fops[k];
+      emitFloat(out, op2);
+      out << ");";
+    } else if (op1.type == fracType && op2.type == fracType) {
+      out << "stq(" << location(temp) << ", " << qops[k] << "(ldq(" << location(op1) << "), ldq(" << location(op2) << ")));";
+    } else {
+      return false;
+    }
+  }
+    break;
+  case offsetOpr:
+    // temp = op1[op2]
+    out << "sti(" << location(temp) << ", ldi(" << location(op1) << " + ";
+    emitInt(out, op2);
+    out << "));";
+    break;
+  case indexCopyOpr:
+    // temp[op1] = op2
+    out << "sti(" << location(temp) << " + ";
+    emitInt(out, op1);
+    out << ", ";
+    emitInt(out, op2);
+    out << ");";
+    break;
+  case jeOpr:
+    if (op1.type == intType && op2.type == intType) {
+      out << "if (";
+      emitInt(out, op1);
+      out << " == ";
+      emitInt(out, op2);
+      out << ")";
+    } else if (isNumber(op1.type) && isNumber(op2.type)) {
+      out << "if (";
+      emitFloat(out, op1);
+      out << " == ";
+      emitFloat(out, op2);
+      out << ")";
+    } else if (op1.type == fracType && op2.type == fracType) {
+      out << "if (memcmp(mem + " << location(op1) << ", mem + " << location(op2) << ", 8) == 0)";
+    } else {
+      return false;
+    }
+    out << " goto L" << instr.getDest() << ";";
+    break;
+  case condJmpOpr: /* TBD */
+  case UNKNOWNOpr:
+  default:
+    return false;
+  }
+
+  return true;
+}
+
+void CBackend::emit(OutBuf& out) {
+  const int n = code->getNextInstr();
+  const int size = mem.getSize();
+  const unsigned char* storage = (const unsigned char*)mem.retrieve(0);
+
+  out << "/* Generated by tinycomp */\n\n";
+
+  // memory, with the initial value of its bytes up to the last one that is not 0
+  int used = size;
+  while (used > 0 && storage[used - 1] == 0) {
+    used--;
+  }
+  out << "static _Alignas(8) unsigned char mem[" << (size > 0 ? size : 1) << "]";
+  if (used > 0) {
+    out << " = {";
+    for (int k = 0; k < used; k++) {
+      out << ((k % 16 == 0) ? "\n  " : " ") << (unsigned int)storage[k] << ",";
+    }
+    out << "\n}";
+  }
+  out << ";\n\n";
+
+  out << "static const int canonical = " << (canonical ? 1 : 0) << ";\n\n";
+  out << prelude;
+
+  // only the targets of a jump get a label
+  vector<bool> target(n + 1, false);
+  for (int i = 0; i < n; i++) {
+    const TacInstr& instr = code->getInstr(i);
+    if ((instr.getOp() == jmpOpr || instr.getOp() == jeOpr) && instr.getDest() >= 0 && instr.getDest() < n) {
+      target[instr.getDest()] = true;
+    }
+  }
+
+  out << "static int run(void) {\n";
+  for (int i = 0; i < n; i++) {
+    if (target[i]) {
+      out << "L" << i << ":\n";
+    }
+    out << "  /*";
+    out.putInt(i, 4);
+    out << " */ ";
+    if (!emitInstr(out, i)) {
+      out << "return fail(\"unsupported instruction\", " << i << ");";
+    }
+    out << '\n';
+  }
+  out << "  return 0;\n";
+  out << "}\n\n";
+
+  // the final value of the variables, as SymTbl::printValues() prints them
+  out << "int main(void) {\n";
+  out << "  int res = run();\n";
+  vector<VarAddress*> vars;
+  sym->getVariables(vars);
+  for (size_t k = 0; k < vars.size(); k++) {
+    VarAddress* v = vars[k];
+    out << "  printf(\"" << (const Address*)v;
+    switch (v->getType()) {
+    case intType:
+      out << " = %d\\n\", ldi(" << v->getOffset() << "));\n";
+      break;
+    case floatType:
+      out << " = %g\\n\", ldf(" << v->getOffset() << "));\n";
+      break;
+    case fracType:
+      out << " = %d|%d\\n\", ldq(" << v->getOffset() << ").num, ldq(" << v->getOffset() << ").denom);\n";
+      break;
+    default:
+      out << " = ?\\n\");\n";
+      break;
+    }
+  }
+  out << "  return res;\n";
+  out << "}\n";
+}
@@ -0,0 +1,49 @@
+#ifndef CGEN_HPP_
+#define CGEN_HPP_
+
+/**
+ * @file cgen.hpp
+ * @brief This header file contains the backend that translates
+ * the 3-addr code produced by tinycomp to a C program.
+ */
+
+#include "tinycomp.hpp"
+#include "outbuf.hpp"
+
+/** An ahead-of-time backend, emitting the code stored in a TargetCode as a
+ *  self-contained C translation unit.
+ *
+ *  Memory becomes a static byte array of the same size and layout, so that
+ *  variables and temporaries keep their offsets; each TacInstr becomes a
+ *  statement, preceded by a numbered label when some jump targets it, and
+ *  jumps become gotos. Once run, the program prints the final value of the
+ *  variables exactly as the Interpreter does, and it fails with the same
+ *  runtime errors. The output only needs a C99 compiler (e.g. gcc -O2).
+ */
+class CBackend {
+private:
+  TargetCode* code;
+  Memory& mem;
+  SymTbl* sym;
+  bool canonical;
+
+  int location(const Operand& o);
+  void emitInt(OutBuf& out, const Operand& o);
+  void emitFloat(OutBuf& out, const Operand& o);
+  bool emitInstr(OutBuf& out, int i);
+
+  // Stop the compiler from generating methods of copy the object
+  CBackend(CBackend const& copy);            // Not to be implemented
+  CBackend& operator=(CBackend const& copy); // Not to be implemented
+public:
+  /** Constructor; binds the backend to the code, to the memory holding
+   *  variables and temporaries, and to the symbol table naming the variables.
+   *  When canonical is set, the result of each fraction operation is reduced.
+   */
+  CBackend(TargetCode* code, Memory& mem, SymTbl* sym, bool canonical);
+
+  /** Prints out the C program */
+  void emit(OutBuf& out);
+};
+
+#endif //CGEN_HPP_
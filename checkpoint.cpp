@@ -0,0 +1,147 @@
+#include <cstring>
+
+using namespace std;
+
+#include "checkpoint.hpp"
+
+Checkpoints::Checkpoints(const SourceBuffer& src)
+  : source(src.getBase()), size(src.getSize()), declsEnd(0), resumed(-1), skipped(false), valid(true) {
+}
+
+void Checkpoints::declaration(const char* end) {
+  if (resumed >= 0) {
+    // read from a copy of the declarations, which end where they did before
+    return;
+  }
+  if (end < source || end > source + size) {
+    valid = false;
+    return;
+  }
+  declsEnd = end - source;
+}
+
+void Checkpoints::statement(const char* end, TargetCode& target, Memory& mem, PatchList nextlist) {
+  // a statement not scanned in place (e.g. from a copy flex made) can not be placed in the source
+  if (!valid || end < source || end > source + size) {
+    valid = false;
+    return;
+  }
+
+  Point p;
+  p.end = end - source;
+  p.instrs = target.getNextInstr();
+  p.temps = mem.getTemps();
+  p.jumps = jumps.size();
+  target.getJumps(nextlist, jumps);
+  p.count = jumps.size() - p.jumps;
+  points.push_back(p);
+}
+
+void Checkpoints::finish(TargetCode& target, Memory& mem) {
+  code.assign(target.getCode(), target.getCode() + target.getNextInstr());
+
+  types.clear();
+  for (TempAddress* temp : mem.getTemporaries()) {
+    types.push_back(temp->getType());
+  }
+}
+
+/* The binary form: the sizes of the arrays, and then the arrays themselves */
+struct Sizes {
+  int32_t declsEnd;
+  int32_t points;
+  int32_t jumps;
+  int32_t instrs;
+  int32_t temps;
+};
+
+void Checkpoints::save(string& data) const {
+  Sizes s = { declsEnd, (int32_t)points.size(), (int32_t)jumps.size(), (int32_t)code.size(), (int32_t)types.size() };
+
+  data.append((const char*)&s, sizeof(s));
+  data.append((const char*)points.data(), points.size() * sizeof(Point));
+  data.append((const char*)jumps.data(), jumps.size() * sizeof(int32_t));
+  data.append((const char*)code.data(), code.size() * sizeof(TacInstr));
+  data.append((const char*)types.data(), types.size());
+}
+
+bool Checkpoints::load(const string& data, size_t at, size_t common) {
+  Sizes s;
+  if (at > data.size() || data.size() - at < sizeof(s)) {
+    return false;
+  }
+  memcpy(&s, data.data() + at, sizeof(s));
+  at += sizeof(s);
+
+  if (s.declsEnd <= 0 || s.points <= 0 || s.jumps < 0 || s.instrs < 0 || s.temps < 0
+      || data.size() - at != (size_t)s.points * sizeof(Point) + (size_t)s.jumps * sizeof(int32_t)
+                             + (size_t)s.instrs * sizeof(TacInstr) + (size_t)s.temps) {
+    return false;
+  }
+
+  points.resize(s.points);
+  memcpy(points.data(), data.data() + at, points.size() * sizeof(Point));
+  at += points.size() * sizeof(Point);
+
+  // the last statement entirely inside the common part (the ends only grow)
+  int k = s.points - 1;
+  while (k >= 0 && (size_t)points[k].end > common) {
+    k--;
+  }
+  if (k < 0 || points[k].end <= s.declsEnd || (size_t)points[k].end > size
+      || points[k].instrs < 0 || points[k].instrs > s.instrs || points[k].temps < 0 || points[k].temps > s.temps
+      || points[k].jumps < 0 || points[k].count < 0 || points[k].jumps > s.jumps - points[k].count) {
+    points.clear();
+    return false;
+  }
+
+  jumps.resize(s.jumps);
+  memcpy(jumps.data(), data.data() + at, jumps.size() * sizeof(int32_t));
+  at += jumps.size() * sizeof(int32_t);
+
+  code.assign(s.instrs, TacInstr(UNKNOWNOpr, Operand(), Operand(), Operand()));
+  memcpy((void*)code.data(), data.data() + at, code.size() * sizeof(TacInstr));
+  at += code.size() * sizeof(TacInstr);
+
+  types.assign(data.begin() + at, data.end());
+
+  // the jumps of the nextlist must be in the code restored
+  const Point& p = points[k];
+  for (int j = p.jumps; j < p.jumps + p.count; j++) {
+    if (jumps[j] < 0 || jumps[j] >= p.instrs) {
+      points.clear();
+      jumps.clear();
+      code.clear();
+      types.clear();
+      return false;
+    }
+  }
+
+  // the statements that follow are recorded again, as they are parsed
+  points.resize(k + 1);
+  jumps.resize(p.jumps + p.count);
+  declsEnd = s.declsEnd;
+  resumed = k;
+  return true;
+}
+
+size_t Checkpoints::skip() {
+  skipped = true;
+  return points[resumed].end;
+}
+
+PatchList Checkpoints::restore(TargetCode& target, Memory& mem) {
+  const Point& p = points[resumed];
+
+  target.append(code.data(), p.instrs);
+  for (int t = 0; t < p.temps; t++) {
+    mem.getNewTemp((typeName)types[t]);
+  }
+
+  // the jumps are linked again, in the order they were listed
+  PatchList nextlist;
+  for (int j = p.jumps; j < p.jumps + p.count; j++) {
+    nextlist = target.merge(nextlist, target.makelist(jumps[j]));
+  }
+  return nextlist;
+}
@@ -0,0 +1,127 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+/**
+ * @file checkpoint.hpp
+ * @brief This header file contains the checkpoints of a parse, which let
+ * the parse of an edited program resume after its unchanged statements.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "tinycomp.hpp"
+#include "source.hpp"
+
+/** The state of the parse of a program after each of its statements (the
+ *  ones at the top level, not those in the body of a while or an if).
+ *
+ *  While a program is parsed, the grammar records where each statement
+ *  ends in the source, how many instructions and temporaries have been
+ *  generated so far, and the jumps still waiting for the next statement
+ *  (its nextlist); once the whole program is parsed, the code and the
+ *  types of the temporaries are kept as well, before any pass rewrites
+ *  them. The Cache stores all of this next to the program.
+ *
+ *  Another program with the same declarations and first statements is
+ *  then parsed from the first statement that differs: the scanner reads
+ *  the declarations, which fill the symbol table and lay out the variables
+ *  as before, and then hands the parser a RESUME token instead of the
+ *  unchanged statements, skipping to the ones that follow. The action of
+ *  RESUME restores the code and temporaries of those statements (see
+ *  restore()), and the parse goes on as if it had read them. The passes
+ *  then run on the whole code, as usual.
+ */
+class Checkpoints {
+public:
+  /** The state of the parse after a statement */
+  struct Point {
+    std::int32_t end;     /*!< the offset in the source just past the ';' of the statement */
+    std::int32_t instrs;  /*!< the number of instructions generated so far */
+    std::int32_t temps;   /*!< the number of temporaries created so far */
+    std::int32_t jumps;   /*!< the first jump of the nextlist of the statement, in jumps */
+    std::int32_t count;   /*!< the number of jumps in the nextlist */
+  };
+
+private:
+  /* the program being parsed */
+  char* source;
+  std::size_t size;
+
+  /* the offset just past the ';' of the last declaration */
+  std::int32_t declsEnd;
+  std::vector<Point> points;
+  /* the nextlists of the points, one after the other */
+  std::vector<std::int32_t> jumps;
+  /* the code as parsed, and the type of each temporary, in the order they were created */
+  std::vector<TacInstr> code;
+  std::vector<std::uint8_t> types;
+
+  /* the point the parse resumes from (-1 if it starts from the beginning),
+     and whether the scanner has skipped to it yet */
+  int resumed;
+  bool skipped;
+  /* cleared when a checkpoint could not be placed in the source */
+  bool valid;
+
+  // Stop the compiler from generating methods of copy the object
+  Checkpoints(Checkpoints const& copy);            // Not to be implemented
+  Checkpoints& operator=(Checkpoints const& copy); // Not to be implemented
+public:
+  /** Constructor for the (still empty) checkpoints of the program in src */
+  Checkpoints(const SourceBuffer& src);
+
+  /** Records the end of a declaration, just before end; called by the parser */
+  void declaration(const char* end);
+
+  /** Records the state of the parse after a statement ending just before
+   *  end, whose nextlist is given; called by the parser.
+   */
+  void statement(const char* end, TargetCode& target, Memory& mem, PatchList nextlist);
+
+  /** Keeps the code and the temporaries of the program, once it is parsed */
+  void finish(TargetCode& target, Memory& mem);
+
+  /** Returns true if the checkpoints can be stored: they were all placed in
+   *  the source, and the program was parsed to its end.
+   */
+  bool complete() const { return valid && !points.empty() && !code.empty(); }
+
+  /** Appends the checkpoints to data, in a binary form only read back by load() */
+  void save(std::string& data) const;
+
+  /** Reads back the checkpoints saved at data[at...] for another version of
+   *  the program (the first common bytes of which are the same), and picks
+   *  the last one the parse of this program can resume from.
+   *  Returns false if there is none; the checkpoints are left empty then.
+   */
+  bool load(const std::string& data, std::size_t at, std::size_t common);
+
+  /** Returns the program being parsed */
+  char* getSource() const { return source; }
+
+  /** Returns the size of the program in bytes */
+  std::size_t getSize() const { return size; }
+
+  /** Returns true if the scanner still has to skip the unchanged statements */
+  bool resuming() const { return resumed >= 0 && !skipped; }
+
+  /** Returns the length of the declarations, which the scanner reads first when resuming */
+  std::size_t getDeclsEnd() const { return declsEnd; }
+
+  /** Returns the offset of the first statement to be parsed after the
+   *  declarations; called by the scanner when it skips to it.
+   */
+  std::size_t skip();
+
+  /** Restores the code and temporaries of the unchanged statements, and
+   *  returns the nextlist of the last one; the action of RESUME.
+   */
+  PatchList restore(TargetCode& target, Memory& mem);
+
+  /** Returns the number of statements the parse did not read again */
+  int getReused() const { return resumed + 1; }
+};
+
+#endif //CHECKPOINT_HPP_
@@ -0,0 +1,228 @@
+#include <iostream>
+#include <chrono>
+#include <stdexcept>
+
+using namespace std;
+
+#include "context.hpp"
+#include "interp.hpp"
+#include "jit.hpp"
+#include "cgen.hpp"
+#include "image.hpp"
+
+bool Options::set(const string& flag) {
+  if (flag == "--run") {
+    run = true;
+  } else if (flag == "--jit") {
+    jit = true;
+  } else if (flag == "--emit=c") {
+    emitC = true;
+  } else if (flag == "--emit=image") {
+    emitImage = true;
+  } else if (flag == "--lex") {
+    lexOnly = true;
+  } else if (flag == "--canonical") {
+    canonical = true;
+  } else if (flag == "--stats") {
+    stats = true;
+  } else if (flag == "--profile") {
+    profile = true;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+string Options::flags() const {
+  string s;
+  if (run) s += " --run";
+  if (jit) s += " --jit";
+  if (emitC) s += " --emit=c";
+  if (emitImage) s += " --emit=image";
+  if (lexOnly) s += " --lex";
+  if (canonical) s += " --canonical";
+  if (stats) s += " --stats";
+  if (profile) s += " --profile";
+  return s.empty() ? s : s.substr(1);
+}
+
+/** The number of loops listed by --profile */
+static const int HOT_LOOPS = 10;
+
+CompilerContext::CompilerContext(ostream& err)
+  : arena("ir"), sym(mem), cfg(&code), peephole(&code), lvn(&code), liveness(&code, mem),
+    emitter(&code, mem), err(err), errors(0), checkpoints(nullptr), semicolon(nullptr) {
+}
+
+/** Splits the program into tokens, and prints out the lexing throughput */
+static int lex(CompilerContext* ctx, FILE* in, SourceBuffer& src) {
+  auto start = chrono::steady_clock::now();
+  long tokens = lexSource(ctx, in, src);
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  ctx->err << "Lexed " << tokens << " tokens";
+  if (src.getBase() != nullptr) {
+    ctx->err << " (" << src.getSize() << " bytes)";
+  }
+  ctx->err << " in " << secs << " s";
+  if (src.getBase() != nullptr && secs > 0) {
+    ctx->err << " (" << src.getSize() / secs / 1e6 << " MB/s)";
+  }
+  ctx->err << endl;
+  return 0;
+}
+
+int CompilerContext::compile(FILE* in, SourceBuffer& src, const Options& opt, OutBuf& out) {
+  // everything allocated with new by the grammar actions (and the passes) goes in the arena
+  Arena* previous = Arena::current();
+  Arena::setCurrent(&arena);
+
+  emitter.setCanonical(opt.canonical);
+  stats.start(opt.stats);
+  errors = 0;
+
+  int res;
+  try {
+    if (opt.lexOnly) {
+      res = lex(this, in, src);
+      stats.lap("lex");
+    } else if (stats.isEnabled()) {
+      // split into tokens first, so that the lexer and the parser are timed apart
+      res = parseTokens(this, in, src);
+      stats.lap("parse");
+    } else {
+      res = parseSource(this, in, src);
+    }
+  } catch (const length_error& e) {
+    // the program does not fit in memory
+    err << e.what() << endl;
+    res = 1;
+  }
+  if (res == 0 && errors > 0) {
+    // e.g. a constant out of range, or an unknown character
+    res = 1;
+  }
+
+  if (res == 0 && !opt.lexOnly) {
+    if (checkpoints != nullptr) {
+      checkpoints->finish(code, mem);
+    }
+    stats.count(code, mem);
+
+    cfg.run();
+    stats.lap("cfg");
+    peephole.run();
+    stats.lap("peephole");
+    lvn.run();
+    stats.lap("lvn");
+    liveness.run();
+    stats.lap("liveness");
+
+    if (opt.emitC) {
+      CBackend backend(&code, mem, &sym, opt.canonical);
+      backend.emit(out);
+      stats.lap("emit");
+    } else if (opt.emitImage) {
+      ImageBackend backend(&code, mem, &sym, opt.canonical);
+      backend.emit(out);
+      stats.lap("emit");
+    } else if (opt.jit && !opt.profile) {
+      Jit native(&code, mem, opt.canonical);
+      res = native.run(err);
+
+      sym.printValues(out);
+      out.flush();
+      stats.lap("run");
+
+      err << "Ran " << native.getCodeSize() << " bytes of native code in " << native.getSeconds() << " s" << endl;
+      err << "Jump threading removed " << cfg.getRemoved() << " instructions" << endl;
+      err << "Peephole removed " << peephole.getRemoved() << " instructions" << endl;
+      err << "Value numbering removed " << lvn.getRemoved() << " instructions" << endl;
+    } else if (!opt.run && !opt.profile) {
+      // print out the output IR, as well as some other info
+      // useful for debugging
+      printOut(out);
+      out.flush();
+      stats.lap("print");
+    } else {
+      Profile profile;
+      Interpreter vm(&code, mem, opt.canonical);
+      if (opt.profile) {
+        vm.setProfile(&profile);
+      }
+      res = vm.run(err);
+
+      sym.printValues(out);
+      if (opt.profile) {
+        out << '\n';
+        out << "== Profile ==\n";
+        code.printOut(mem, &sym, out, &profile);
+        out << '\n';
+        out << "== Hottest Loops ==\n";
+        code.printLoops(profile, out, HOT_LOOPS);
+      }
+      out.flush();
+      stats.lap("run");
+
+      double secs = vm.getSeconds();
+      err << "Executed " << vm.getExecuted() << " instructions in " << secs << " s";
+      if (secs > 0) {
+        err << " (" << (long long)(vm.getExecuted() / secs) << " instr/s)";
+      }
+      err << endl;
+      err << "Jump threading removed " << cfg.getRemoved() << " instructions" << endl;
+      err << "Peephole removed " << peephole.getRemoved() << " instructions" << endl;
+      err << "Value numbering removed " << lvn.getRemoved() << " instructions" << endl;
+    }
+  }
+
+  if (stats.isEnabled()) {
+    stats.printOut(err, code, mem, arena);
+  }
+
+  Arena::setCurrent(previous);
+  return res;
+}
+
+void CompilerContext::reset() {
+  // the addresses in the symbol table and memory live in the arena: forget them first
+  sym.reset();
+  mem.reset();
+  code.reset();
+  arena.reset();
+}
+
+void CompilerContext::printOut(OutBuf& out) {
+  out << "*********\n";
+  out << "Size of int: " << sizeof(int) << '\n';
+  out << "Size of float: " << sizeof(float) << '\n';
+  out << "Size of Fraction: " << sizeof(Fraction) << '\n';
+  out << "*********\n";
+  out << '\n';
+  out << "== Symbol Table ==\n";
+  sym.printOut(out);
+  out << '\n';
+  out << "== Memory Dump ==\n";
+  // mem.hexdump();
+  mem.printOut(&sym, out);
+  out << '\n';
+  out << '\n';
+  out << "== Output (3-addr code) ==\n";
+  code.printOut(mem, &sym, out);
+  out << '\n';
+  out << "== Control Flow ==\n";
+  cfg.printOut(out);
+  out << '\n';
+  out << "== Peephole ==\n";
+  peephole.printOut(out);
+  out << '\n';
+  out << "== Value Numbering ==\n";
+  out << "removed " << lvn.getRemoved() << " instructions\n";
+  out << '\n';
+  out << "== Temporaries ==\n";
+  liveness.printOut(out);
+  out << '\n';
+  out << "== Arena ==\n";
+  arena.printOut(out);
+  sym.printPool(out);
+}
@@ -0,0 +1,114 @@
+#ifndef CONTEXT_HPP_
+#define CONTEXT_HPP_
+
+/**
+ * @file context.hpp
+ * @brief This header file contains the compiler context, which holds
+ * all the state of the compilation of one program.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "tinycomp.hpp"
+#include "symtbl.hpp"
+#include "cfg.hpp"
+#include "peephole.hpp"
+#include "lvn.hpp"
+#include "liveness.hpp"
+#include "emitter.hpp"
+#include "source.hpp"
+#include "checkpoint.hpp"
+#include "stats.hpp"
+
+/** What to do with a program, as given on the command line */
+struct Options {
+  bool run = false;        /*!< execute the 3-addr code with the Interpreter */
+  bool jit = false;        /*!< execute the 3-addr code with the Jit */
+  bool emitC = false;      /*!< print out the 3-addr code as a C program */
+  bool emitImage = false;  /*!< print out the 3-addr code as a binary Image */
+  bool lexOnly = false;    /*!< only split the program into tokens */
+  bool canonical = false;  /*!< keep fractions reduced */
+  bool stats = false;      /*!< print out the statistics of the compilation, as JSON */
+  bool profile = false;    /*!< as run, then print out the code annotated with how often each instruction ran */
+
+  /** Sets the option named by a command-line flag (e.g. "--run").
+   *  Returns false if there is no such option.
+   */
+  bool set(const std::string& flag);
+
+  /** Returns the flags that set these options, separated by spaces */
+  std::string flags() const;
+};
+
+/** Everything needed to compile (and run) one program: the memory, the
+ *  symbol table, the code and the passes working on them, plus the
+ *  stream errors and statistics are reported to.
+ *
+ *  Nothing is shared between two contexts (the scanner and the parser are
+ *  reentrant, and take the context as a parameter), so several programs
+ *  can be compiled at once, each by its own thread with its own context.
+ *  The members are public, since the grammar actions work on them directly.
+ */
+class CompilerContext {
+private:
+  // Stop the compiler from generating methods of copy the object
+  CompilerContext(CompilerContext const& copy);            // Not to be implemented
+  CompilerContext& operator=(CompilerContext const& copy); // Not to be implemented
+public:
+  /** Owns the addresses and attributes of the compilation */
+  Arena arena;
+  /** The memory of the program (variables and temporaries) */
+  Memory mem;
+  /** The symbol table */
+  HashSymTbl sym;
+  /** The 3-addr code */
+  TargetCode code;
+  /** The passes run on the code once it is parsed, in this order */
+  FlowGraph cfg;
+  Peephole peephole;
+  ValueNumbering lvn;
+  Liveness liveness;
+  /** Type-checks expressions and generates their code */
+  Emitter emitter;
+  /** The statistics of the compilation (gathered only with --stats) */
+  Stats stats;
+  /** Where errors and statistics are printed out */
+  std::ostream& err;
+  /** The number of errors reported (by yyerror()) while compiling the program;
+   *  the scanner goes on after an error, so the compilation fails if it is not 0.
+   */
+  int errors;
+  /** Where the parse records its checkpoints, or resumes from one (NULL
+   *  unless the program is compiled through the Cache)
+   */
+  Checkpoints* checkpoints;
+  /** Just past the last ';' scanned, where the statement (or declaration) it ends is over */
+  const char* semicolon;
+
+  /** Constructor for an empty context.
+   *  @param err The stream errors and statistics are printed out to
+   */
+  CompilerContext(std::ostream& err);
+
+  /** Compiles the program read from in (or already mapped into src, when
+   *  that is not empty), and then prints it out or runs it, as requested
+   *  by opt; whatever the program prints goes to out. With opt.stats, the
+   *  statistics are printed out to err at the end.
+   *  Returns 0 on success, non-zero if the program could not be compiled or failed.
+   */
+  int compile(FILE* in, SourceBuffer& src, const Options& opt, OutBuf& out);
+
+  /** Empties the memory, symbol table, code and arena, so that the context
+   *  can compile another program; what they allocated is kept for reuse.
+   *  The passes need no reset, since each run starts afresh.
+   */
+  void reset();
+
+  /** Prints out the symbol table, memory map and 3-addr code, as well as
+   *  the statistics of the passes
+   */
+  void printOut(OutBuf& out);
+};
+
+#endif //CONTEXT_HPP_
@@ -0,0 +1,409 @@
+#include <iostream>
+#include <climits>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "emitter.hpp"
+
+Emitter::Emitter(TargetCode* code, Memory& mem) : code(code), mem(mem), canonical(false) {
+}
+
+void Emitter::setCanonical(bool canonical) {
+  this->canonical = canonical;
+}
+
+/** Returns q in canonical form when fractions are kept reduced, q otherwise */
+Fraction Emitter::normalize(const Fraction& q) const {
+  return canonical ? reduce(q) : q;
+}
+
+/** Folds "ex1 op ex2" when both operands are constants.
+ *  The result is computed exactly as the generated code would compute it
+ *  at runtime (ints wrap around, an int is promoted to float or to a
+ *  fraction); NULL is returned when the operands are not both constants,
+ *  or when the operation must be left to fail at runtime (an integer
+ *  division by zero).
+ */
+ConstAddress* Emitter::fold(oprEnum op, ExprAttr* ex1, ExprAttr* ex2) const {
+  ConstAddress * c1 = ex1->getConst(),
+    * c2 = ex2->getConst();
+
+  if (c1 == nullptr || c2 == nullptr) {
+    return nullptr;
+  }
+
+  const typeName t1 = c1->getType(),
+    t2 = c2->getType();
+
+  if (t1 == intType && t2 == intType) {
+    const int x = c1->getInt(),
+      y = c2->getInt();
+
+    switch (op) {
+    case addOpr: return new ConstAddress((int)wrapAdd(x, y));
+    case mulOpr: return new ConstAddress((int)wrapMul(x, y));
+    case divOpr:
+      if (y == 0 || (x == INT_MIN && y == -1)) {
+        return nullptr;
+      }
+      return new ConstAddress(x / y);
+    default: return nullptr;
+    }
+  }
+
+  if (t1 == fracType || t2 == fracType) {
+    // only fraction * int is defined between a fraction and another type
+    if (t1 != t2 && (op != mulOpr || (t1 != intType && t2 != intType))) {
+      return nullptr;
+    }
+
+    Fraction x = (t1 == fracType) ? c1->getFraction() : Fraction(c1->getInt(), 1),
+      y = (t2 == fracType) ? c2->getFraction() : Fraction(c2->getInt(), 1);
+
+    switch (op) {
+    case addOpr: return new ConstAddress(normalize(x + y));
+    case mulOpr: return new ConstAddress(normalize(x * y));
+    case divOpr: return new ConstAddress(normalize(x / y));
+    default: return nullptr;
+    }
+  }
+
+  // float, possibly with an int promoted to float (only by a multiplication)
+  if (t1 != t2 && op != mulOpr) {
+    return nullptr;
+  }
+
+  const float x = (t1 == floatType) ? c1->getFloat() : (float)c1->getInt(),
+    y = (t2 == floatType) ? c2->getFloat() : (float)c2->getInt();
+
+  switch (op) {
+  case addOpr: return new ConstAddress(x + y);
+  case mulOpr: return new ConstAddress(x * y);
+  case divOpr: return new ConstAddress(x / y);
+  default: return nullptr;
+  }
+}
+
+/** Folds the comparison "ex1 == ex2" (strict, or lax when lax is set)
+ *  when both operands are constants of types that can be compared.
+ *  Returns 1 when the comparison holds, 0 when it does not, -1 when it
+ *  can not be folded.
+ */
+int Emitter::foldEqual(bool lax, ExprAttr* ex1, ExprAttr* ex2) const {
+  ConstAddress * c1 = ex1->getConst(),
+    * c2 = ex2->getConst();
+
+  if (c1 == nullptr || c2 == nullptr) {
+    return -1;
+  }
+
+  const typeName t1 = c1->getType(),
+    t2 = c2->getType();
+
+  if (t1 == t2 && t1 == intType) {
+    return c1->getInt() == c2->getInt();
+  }
+  if (t1 == t2 && t1 == floatType) {
+    return c1->getFloat() == c2->getFloat();
+  }
+  if (t1 == t2 && t1 == fracType && !lax) {
+    return c1->getFraction().num == c2->getFraction().num
+      && c1->getFraction().denom == c2->getFraction().denom;
+  }
+  if (lax && (t1 == fracType || t2 == fracType)) {
+    // a fraction is laxly compared through the integer quotient num/denom,
+    // or by value when fractions are canonical
+    Fraction x = (t1 == fracType) ? c1->getFraction() : Fraction(c1->getInt(), 1),
+      y = (t2 == fracType) ? c2->getFraction() : Fraction(c2->getInt(), 1);
+
+    if (t1 != t2 && t1 != intType && t2 != intType) {
+      return -1;
+    }
+    if (canonical) {
+      return x.num == y.num && x.denom == y.denom;
+    }
+    if (x.denom == 0 || y.denom == 0
+        || (x.num == INT_MIN && x.denom == -1) || (y.num == INT_MIN && y.denom == -1)) {
+      return -1;
+    }
+    return x.num / x.denom == y.num / y.denom;
+  }
+
+  return -1;
+}
+
+/** Returns the address of the value of ex; a fraction constant, which does
+ *  not fit in an instruction, is first copied into a temporary.
+ */
+Address* Emitter::materialize(ExprAttr* ex) {
+  ConstAddress * q = ex->getConst();
+
+  if (q == nullptr || q->getType() != fracType) {
+    return ex->getAddr();
+  }
+
+  const int width = Type::width(fracType);
+  TempAddress * temp = mem.getNewTemp(fracType);
+
+  code->gen(indexCopyOpr, new ConstAddress(0), new ConstAddress(q->getFraction().num), temp);
+  code->gen(indexCopyOpr, new ConstAddress(width/2), new ConstAddress(q->getFraction().denom), temp);
+
+  return temp;
+}
+
+/** Returns the address of the value of ex as a fraction: an int is
+ *  promoted (to ex|1) into a temporary, by a converting copy.
+ */
+Address* Emitter::promote(ExprAttr* ex) {
+  if (ex->getType() != intType) {
+    return materialize(ex);
+  }
+
+  TempAddress * temp = mem.getNewTemp(fracType);
+  code->gen(copyOpr, temp, ex->getAddr());
+  return temp;
+}
+
+/** Returns the address of the integer quotient num/denom of the fraction ex,
+ *  computed by a converting copy into a temporary. The quotient of a constant
+ *  is a constant itself, unless the division fails, which is then left to
+ *  happen at runtime.
+ */
+Address* Emitter::quotient(ExprAttr* ex) {
+  ConstAddress * c = ex->getConst();
+
+  if (c != nullptr) {
+    const Fraction q = c->getFraction();
+    if (q.denom != 0 && !(q.num == INT_MIN && q.denom == -1)) {
+      return new ConstAddress(q.num / q.denom);
+    }
+  }
+
+  TempAddress * temp = mem.getNewTemp(intType);
+  code->gen(copyOpr, temp, materialize(ex));
+  return temp;
+}
+
+/** "ex1 op ex2": operands of the same type, or an int multiplied by a
+ *  float or by a fraction (and promoted to it); nothing else is defined.
+ */
+template<oprEnum op, typeName t1, typeName t2>
+struct ArithRule {
+  static const typeName result = Type::join(t1, t2);
+  static const bool defined = (t1 == t2) || (op == mulOpr && result != ERROR);
+
+  static ExprAttr* emit(Emitter& e, ExprAttr* ex1, ExprAttr* ex2) {
+    if (!defined) {
+      return nullptr;
+    }
+
+    ConstAddress * c = e.fold(op, ex1, ex2);
+    if (c != nullptr) {
+      return new ExprAttr(c);
+    }
+
+    TempAddress * temp = e.mem.getNewTemp(result);
+    if (result == fracType && t1 != t2) {
+      // the int is promoted to a fraction (ex|1), then the fractions are multiplied as a whole
+      e.code->gen(op, e.promote(ex1), e.promote(ex2), temp);
+      return new ExprAttr(temp, result);
+    }
+
+    // an int promoted to float is converted by the instruction itself
+    int i = e.code->gen(op, e.materialize(ex1), e.materialize(ex2), temp);
+    // a product is named by its temporary, a sum or a quotient by its instruction
+    return (op == mulOpr) ? new ExprAttr(temp, result) : new ExprAttr(i, result);
+  }
+};
+
+/** "ex1 = ex2" (strict) is defined between operands of the same type;
+ *  "ex1 == ex2" (lax) also compares a fraction to an int.
+ */
+template<bool lax, typeName t1, typeName t2>
+struct EqualRule {
+  static const bool defined = (t1 == t2) || (lax && Type::join(t1, t2) == fracType);
+
+  static BoolAttr* emit(Emitter& e, ExprAttr* ex1, ExprAttr* ex2) {
+    if (!defined) {
+      return nullptr;
+    }
+
+    TargetCode* code = e.code;
+    int t = -1;
+
+    // comparing two constants needs a single, unconditional jump
+    const int folded = e.foldEqual(lax, ex1, ex2);
+    if (folded >= 0) {
+      t = code->gen(jmpOpr, nullptr, nullptr);
+      return folded ? new BoolAttr(code->makelist(t), PatchList())
+                    : new BoolAttr(PatchList(), code->makelist(t));
+    }
+
+    /** Generate two jumps, the first is for when the comparison
+        is true and the second is for when the comparison is false.
+     */
+    if (t1 == t2 && t1 != fracType) {
+      t = code->gen(jeOpr, ex1->getAddr(), ex2->getAddr(), nullptr);
+    }
+    else if (!lax || e.canonical) {
+      // fractions compared as a whole: both halves must be equal, which for
+      // canonical fractions means that they have the same value
+      t = code->gen(jeOpr, e.promote(ex1), e.promote(ex2), nullptr);
+    }
+    else if (t1 == t2) {
+      // the integer quotients ex1[num]/ex1[denom] and ex2[num]/ex2[denom] are compared
+      Address * u = e.quotient(ex1),
+        * v = e.quotient(ex2);
+      t = code->gen(jeOpr, u, v, nullptr);
+    }
+    else if (t1 == fracType) {
+      t = code->gen(jeOpr, e.quotient(ex1), ex2->getAddr(), nullptr);
+    }
+    else {
+      t = code->gen(jeOpr, e.quotient(ex2), ex1->getAddr(), nullptr);
+    }
+
+    int f = code->gen(jmpOpr, nullptr, nullptr);
+    return new BoolAttr(code->makelist(t), code->makelist(f));
+  }
+};
+
+/** "var := ex": ints and floats are converted into each other, an int is
+ *  promoted to a fraction; a fraction can not be assigned to an int.
+ */
+template<typeName tv, typeName te>
+struct AssignRule {
+  static const bool defined = (tv == te) || Type::join(tv, te) == floatType || (tv == fracType && te == intType);
+
+  static bool emit(Emitter& e, VarAddress* var, ExprAttr* ex) {
+    if (!defined) {
+      return false;
+    }
+
+    ConstAddress * q = ex->getConst();
+    if (tv == fracType && te == fracType && q != nullptr) {
+      /** A constant fraction, which does not fit in an instruction,
+          is stored word by word.
+          num = 0
+          denom = sizeof(Fraction)/2
+          var[num] = q.num
+          var[denom] = q.denom
+       */
+      const int width = Type::width(fracType);
+      e.code->gen(indexCopyOpr, new ConstAddress(0), new ConstAddress(q->getFraction().num), var);
+      e.code->gen(indexCopyOpr, new ConstAddress(width/2), new ConstAddress(q->getFraction().denom), var);
+    }
+    else {
+      // a fraction is copied as a whole (8 bytes); a copy from another type converts the value
+      e.code->gen(copyOpr, var, ex->getAddr());
+    }
+    return true;
+  }
+};
+
+/* The rules, indexed by the types of the operands */
+
+/** The index of a type in the tables of rules (-1 if it is not a type) */
+static int slot(typeName t) {
+  switch (t) {
+  case intType: return 0;
+  case fracType: return 1;
+  case floatType: return 2;
+  default: return -1;
+  }
+}
+
+#define TYPES(rule, ...) \
+  { &rule<__VA_ARGS__, intType>::emit, &rule<__VA_ARGS__, fracType>::emit, &rule<__VA_ARGS__, floatType>::emit }
+#define TABLE(rule, ...) \
+  { TYPES(rule, __VA_ARGS__, intType), TYPES(rule, __VA_ARGS__, fracType), TYPES(rule, __VA_ARGS__, floatType) }
+
+typedef ExprAttr* (*ArithFn)(Emitter&, ExprAttr*, ExprAttr*);
+typedef BoolAttr* (*EqualFn)(Emitter&, ExprAttr*, ExprAttr*);
+typedef bool (*AssignFn)(Emitter&, VarAddress*, ExprAttr*);
+
+/* indexed by op - addOpr */
+static const ArithFn arithRules[3][3][3] = {
+  TABLE(ArithRule, addOpr),
+  TABLE(ArithRule, mulOpr),
+  TABLE(ArithRule, divOpr)
+};
+
+/* indexed by lax */
+static const EqualFn equalRules[2][3][3] = {
+  TABLE(EqualRule, false),
+  TABLE(EqualRule, true)
+};
+
+static const AssignFn assignRules[3][3] = {
+  TYPES(AssignRule, intType),
+  TYPES(AssignRule, fracType),
+  TYPES(AssignRule, floatType)
+};
+
+#undef TABLE
+#undef TYPES
+
+ExprAttr* Emitter::fraction(const Fraction& q) {
+  /** A fraction constant is kept as such, so that it can be folded
+      with other constants; it is loaded into a temporary only when
+      an instruction needs the whole fraction (see materialize()).
+   */
+  return new ExprAttr(new ConstAddress(normalize(q)));
+}
+
+ExprAttr* Emitter::fraction(ExprAttr* num, ExprAttr* denom) {
+  if (num->getType() != intType || denom->getType() != intType) {
+    return nullptr;
+  }
+
+  if (num->getConst() != nullptr && denom->getConst() != nullptr) {
+    return fraction(Fraction(num->getConst()->getInt(), denom->getConst()->getInt()));
+  }
+
+  TempAddress * temp = mem.getNewTemp(fracType);
+  if (canonical) {
+    // num|1 / denom|1 is num|denom, and the division reduces it
+    code->gen(divOpr, promote(num), promote(denom), temp);
+  }
+  else {
+    /** The two halves are stored into the temporary.
+        temp[0] = num
+        temp[sizeof(Fraction)/2] = denom
+     */
+    const int width = Type::width(fracType);
+    code->gen(indexCopyOpr, new ConstAddress(0), num->getAddr(), temp);
+    code->gen(indexCopyOpr, new ConstAddress(width/2), denom->getAddr(), temp);
+  }
+  return new ExprAttr(temp, fracType);
+}
+
+ExprAttr* Emitter::arith(oprEnum op, ExprAttr* ex1, ExprAttr* ex2) {
+  const int s1 = slot(ex1->getType()), s2 = slot(ex2->getType());
+
+  assert(op == addOpr || op == mulOpr || op == divOpr);
+  if (s1 < 0 || s2 < 0) {
+    return nullptr;
+  }
+  return arithRules[op - addOpr][s1][s2](*this, ex1, ex2);
+}
+
+BoolAttr* Emitter::equal(bool lax, ExprAttr* ex1, ExprAttr* ex2) {
+  const int s1 = slot(ex1->getType()), s2 = slot(ex2->getType());
+
+  if (s1 < 0 || s2 < 0) {
+    return nullptr;
+  }
+  return equalRules[lax][s1][s2](*this, ex1, ex2);
+}
+
+bool Emitter::assign(VarAddress* var, ExprAttr* ex) {
+  const int sv = slot(var->getType()), se = slot(ex->getType());
+
+  if (sv < 0 || se < 0) {
+    return false;
+  }
+  return assignRules[sv][se](*this, var, ex);
+}
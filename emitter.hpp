@@ -0,0 +1,76 @@
+#ifndef EMITTER_HPP_
+#define EMITTER_HPP_
+
+/**
+ * @file emitter.hpp
+ * @brief This header file contains the code emitter used by the grammar
+ * actions, which type-checks expressions and generates their 3-addr code.
+ */
+
+#include "tinycomp.hpp"
+
+template<oprEnum op, typeName t1, typeName t2> struct ArithRule;
+template<bool lax, typeName t1, typeName t2> struct EqualRule;
+template<typeName tv, typeName te> struct AssignRule;
+
+/** Translates the operators of the language into 3-addr code.
+ *
+ *  Each combination of an operator with the types of its operands is
+ *  handled by its own instantiation of a rule template (see emitter.cpp),
+ *  in which the promotions of Type::join() are resolved at compile time;
+ *  at runtime, the types of the operands only pick an entry of a table of
+ *  rules. Constant operands are folded as the generated code would compute
+ *  them, and a fraction constant is only stored into a temporary when an
+ *  instruction needs it as a whole.
+ *
+ *  The methods return NULL when the types of the operands do not match;
+ *  the grammar actions report the error.
+ */
+class Emitter {
+private:
+  TargetCode* code;
+  Memory& mem;
+  bool canonical;
+
+  template<oprEnum op, typeName t1, typeName t2> friend struct ArithRule;
+  template<bool lax, typeName t1, typeName t2> friend struct EqualRule;
+  template<typeName tv, typeName te> friend struct AssignRule;
+
+  Fraction normalize(const Fraction& q) const;
+  ConstAddress* fold(oprEnum op, ExprAttr* ex1, ExprAttr* ex2) const;
+  int foldEqual(bool lax, ExprAttr* ex1, ExprAttr* ex2) const;
+  Address* materialize(ExprAttr* ex);
+  Address* promote(ExprAttr* ex);
+  Address* quotient(ExprAttr* ex);
+
+  // Stop the compiler from generating methods of copy the object
+  Emitter(Emitter const& copy);            // Not to be implemented
+  Emitter& operator=(Emitter const& copy); // Not to be implemented
+public:
+  /** Constructor; binds the emitter to the code it appends to and to
+   *  the memory its temporaries are taken from.
+   */
+  Emitter(TargetCode* code, Memory& mem);
+
+  /** Keeps fractions reduced (see reduce()) when canonical is set;
+   *  == then compares the values of two fractions exactly.
+   */
+  void setCanonical(bool canonical);
+
+  /** Returns the attributes of the fraction constant q */
+  ExprAttr* fraction(const Fraction& q);
+
+  /** Returns the attributes of the fraction num|denom (NULL unless both are ints) */
+  ExprAttr* fraction(ExprAttr* num, ExprAttr* denom);
+
+  /** Returns the attributes of "ex1 op ex2", for op one of addOpr, mulOpr, divOpr */
+  ExprAttr* arith(oprEnum op, ExprAttr* ex1, ExprAttr* ex2);
+
+  /** Returns the attributes of the comparison "ex1 == ex2" (lax) or "ex1 = ex2" (strict) */
+  BoolAttr* equal(bool lax, ExprAttr* ex1, ExprAttr* ex2);
+
+  /** Generates the assignment "var := ex"; returns false if the types do not match */
+  bool assign(VarAddress* var, ExprAttr* ex);
+};
+
+#endif //EMITTER_HPP_
@@ -0,0 +1,295 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "image.hpp"
+#include "interp.hpp"
+
+/** The sections of an image are aligned to this many bytes */
+static const size_t ALIGN = 16;
+
+static size_t align(size_t n) {
+  return (n + ALIGN - 1) & ~(ALIGN - 1);
+}
+
+static const char MAGIC[8] = "tcimage";
+
+/*
+ * ImageBackend
+ */
+ImageBackend::ImageBackend(TargetCode* code, Memory& mem, SymTbl* sym, bool canonical)
+  : code(code), mem(mem), sym(sym), canonical(canonical) {
+}
+
+void ImageBackend::emit(OutBuf& out) {
+  vector<VarAddress*> vars;
+  sym->getVariables(vars);
+
+  vector<ImageVar> table(vars.size());
+  string names;
+  for (size_t k = 0; k < vars.size(); k++) {
+    table[k].name = names.size();
+    table[k].offset = vars[k]->getOffset();
+    table[k].type = vars[k]->getType();
+    names.append(vars[k]->getLexeme());
+    names.push_back('\0');
+  }
+
+  ImageHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, MAGIC, sizeof(h.magic));
+  h.version = Image::VERSION;
+  h.flags = canonical ? Image::CANONICAL : 0;
+  h.instrSize = sizeof(TacInstr);
+  h.instrs = code->getNextInstr();
+  h.vars = table.size();
+  h.memSize = mem.getSize();
+  h.namesSize = names.size();
+  h.code = align(sizeof(h));
+  h.variables = align(h.code + (size_t)h.instrs * sizeof(TacInstr));
+  h.memory = align(h.variables + table.size() * sizeof(ImageVar));
+  h.names = align(h.memory + h.memSize);
+
+  static const char zeros[ALIGN] = {0};
+  size_t at = 0;
+  auto section = [&out, &at](uint64_t offset, const void* data, size_t n) {
+    out.write(zeros, offset - at);
+    out.write((const char*)data, n);
+    at = offset + n;
+  };
+
+  section(0, &h, sizeof(h));
+  section(h.code, code->getCode(), (size_t)h.instrs * sizeof(TacInstr));
+  section(h.variables, table.data(), table.size() * sizeof(ImageVar));
+  section(h.memory, mem.retrieve(0), h.memSize);
+  section(h.names, names.data(), names.size());
+}
+
+/*
+ * Image
+ */
+Image::Image()
+  : base(nullptr), size(0), mapped(false), header(nullptr), code(nullptr), vars(nullptr), memory(nullptr),
+    names(nullptr), seconds(0) {
+}
+
+Image::~Image() {
+  if (mapped) {
+    munmap(base, size);
+  }
+}
+
+/** Returns true if o refers to a location (or an instruction) inside the image.
+ *  An instruction operand is only allowed when withInstr is set, and must
+ *  have a temporary (its value is the one stored there). The Interpreter
+ *  reads an operand as wide as its own type, so a location is checked at
+ *  that width, also when it is the temporary of an instruction.
+ */
+bool Image::checkOperand(const Operand& o, bool withInstr) const {
+  int offset;
+
+  switch (o.kind) {
+  case noOpd:
+  case constOpd:
+    return true;
+  case varOpd:
+  case tempOpd:
+    offset = o.val.i;
+    break;
+  case instrOpd:
+    if (!withInstr || o.val.i < 0 || (uint32_t)o.val.i >= header->instrs) {
+      return false;
+    } else {
+      const Operand temp = code[o.val.i].getTemp();
+      if (temp.kind != varOpd && temp.kind != tempOpd) {
+        return false;
+      }
+      offset = temp.val.i;
+    }
+    break;
+  default:
+    return false;
+  }
+
+  const size_t width = Type::width(o.type);
+  return width != 0 && offset >= 0 && (size_t)offset + width <= header->memSize;
+}
+
+/** Checks the code and variables. Returns false (setting error) if they refer outside the image */
+bool Image::check(const char*& error) const {
+  const uint32_t n = header->instrs;
+
+  for (uint32_t i = 0; i < n; i++) {
+    const TacInstr& instr = code[i];
+    const Operand op1 = instr.getOperand1(), op2 = instr.getOperand2(), temp = instr.getTemp();
+
+    if (instr.getOp() > fakeOpr) {
+      error = "unknown operator";
+      return false;
+    }
+    const bool jump = instr.getOp() == jmpOpr || instr.getOp() == jeOpr || instr.getOp() == condJmpOpr;
+    if (jump && (instr.getDest() < 0 || (uint32_t)instr.getDest() >= n)) {
+      error = "jump outside the code";
+      return false;
+    }
+    if (!checkOperand(op1, true) || !checkOperand(op2, true) || (!jump && !checkOperand(temp, false))) {
+      error = "operand outside the memory";
+      return false;
+    }
+
+    // an indexed copy accesses one 4-byte word of its variable, at a constant offset
+    const Operand* index = instr.getOp() == offsetOpr ? &op2 : (instr.getOp() == indexCopyOpr ? &op1 : nullptr);
+    if (index != nullptr) {
+      const Operand& array = instr.getOp() == offsetOpr ? op1 : temp;
+      if (index->kind != constOpd || array.kind == instrOpd || index->val.i < 0
+          || (size_t)index->val.i + 4 > Type::width(array.type)) {
+        error = "index outside the variable";
+        return false;
+      }
+    }
+  }
+
+  // the program must not run past its last instruction
+  if (n > 0 && code[n - 1].getOp() != haltOpr && code[n - 1].getOp() != jmpOpr) {
+    error = "code not ending with a halt";
+    return false;
+  }
+
+  for (uint32_t k = 0; k < header->vars; k++) {
+    if (vars[k].name >= header->namesSize
+        || vars[k].offset + Type::width((typeName)vars[k].type) > header->memSize
+        || Type::width((typeName)vars[k].type) == 0) {
+      error = "variable outside the memory";
+      return false;
+    }
+  }
+  if (header->namesSize > 0 && names[header->namesSize - 1] != '\0') {
+    error = "unterminated name";
+    return false;
+  }
+  return true;
+}
+
+bool Image::map(const char* path, ostream& err) {
+  auto start = chrono::steady_clock::now();
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    err << "Can not open " << path << endl;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ImageHeader)) {
+    err << path << ": not an image" << endl;
+    close(fd);
+    return false;
+  }
+
+  // private and writable: the program writes its memory in place, the file stays as it is
+  void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    err << "Can not map " << path << endl;
+    return false;
+  }
+  base = (char*)p;
+  size = st.st_size;
+  mapped = true;
+
+  if (!load(path, err)) {
+    return false;
+  }
+
+  seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return true;
+}
+
+bool Image::use(char* data, size_t length, ostream& err) {
+  auto start = chrono::steady_clock::now();
+
+  if (length < sizeof(ImageHeader) || (uintptr_t)data % ALIGN != 0) {
+    err << "image in memory: not an image" << endl;
+    return false;
+  }
+  base = data;
+  size = length;
+
+  if (!load("image in memory", err)) {
+    return false;
+  }
+
+  seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return true;
+}
+
+/** Finds the sections of the image at base, and checks them. Returns false
+ *  (and prints out why on err, naming the image name) if it can not be run.
+ */
+bool Image::load(const char* name, ostream& err) {
+  const ImageHeader* h = (const ImageHeader*)base;
+  if (memcmp(h->magic, MAGIC, sizeof(h->magic)) != 0 || h->instrSize != sizeof(TacInstr)) {
+    err << name << ": not an image (or written on another machine)" << endl;
+    return false;
+  }
+  if (h->version != VERSION) {
+    err << name << ": image version " << h->version << ", expected " << VERSION << endl;
+    return false;
+  }
+
+  // every section must be aligned, and inside the file
+  auto inside = [this](uint64_t offset, uint64_t bytes) {
+    return offset % ALIGN == 0 && offset <= size && bytes <= size - offset;
+  };
+  if (!inside(h->code, (uint64_t)h->instrs * sizeof(TacInstr))
+      || !inside(h->variables, (uint64_t)h->vars * sizeof(ImageVar))
+      || !inside(h->memory, h->memSize) || !inside(h->names, h->namesSize)) {
+    err << name << ": truncated image" << endl;
+    return false;
+  }
+
+  header = h;
+  code = (const TacInstr*)(base + h->code);
+  vars = (const ImageVar*)(base + h->variables);
+  memory = (unsigned char*)(base + h->memory);
+  names = base + h->names;
+
+  const char* error = nullptr;
+  if (!check(error)) {
+    err << name << ": damaged image (" << error << ")" << endl;
+    header = nullptr;
+    return false;
+  }
+  return true;
+}
+
+int Image::run(OutBuf& out, ostream& err) {
+  if (header == nullptr) {
+    return 1;
+  }
+
+  Interpreter vm(code, header->instrs, memory, (header->flags & CANONICAL) != 0);
+  int res = vm.run(err);
+
+  for (uint32_t k = 0; k < header->vars; k++) {
+    out << names + vars[k].name << " = ";
+    SymTbl::printValue(out, (typeName)vars[k].type, memory + vars[k].offset);
+    out << '\n';
+  }
+  out.flush();
+
+  double secs = vm.getSeconds();
+  err << "Loaded " << size << " bytes in " << seconds << " s" << endl;
+  err << "Executed " << vm.getExecuted() << " instructions in " << secs << " s";
+  if (secs > 0) {
+    err << " (" << (long long)(vm.getExecuted() / secs) << " instr/s)";
+  }
+  err << endl;
+  return res;
+}
@@ -0,0 +1,140 @@
+#ifndef IMAGE_HPP_
+#define IMAGE_HPP_
+
+/**
+ * @file image.hpp
+ * @brief This header file contains the binary image of a compiled
+ * program, which can be mapped into memory and run without parsing.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include "tinycomp.hpp"
+
+/** The header at the beginning of an image.
+ *
+ *  An image holds, in this order (each section aligned to 16 bytes):
+ *    - the header;
+ *    - the code: the TacInstr array, exactly as in TargetCode (constants
+ *      are stored in the instructions themselves, so there is no pool);
+ *    - the variables: an ImageVar for each one, in alphabetical order;
+ *    - the initial memory, laid out as by Memory;
+ *    - the names of the variables, NUL-terminated.
+ *  All the numbers are in the byte order of the machine that wrote the image;
+ *  the magic and the size of a TacInstr reject the images of another machine.
+ */
+struct ImageHeader {
+  char magic[8];            /*!< "tcimage" */
+  std::uint32_t version;    /*!< Image::VERSION */
+  std::uint32_t flags;      /*!< Image::CANONICAL, if fractions are kept reduced */
+  std::uint32_t instrSize;  /*!< sizeof(TacInstr) */
+  std::uint32_t instrs;     /*!< the number of instructions */
+  std::uint32_t vars;       /*!< the number of variables */
+  std::uint32_t memSize;    /*!< the size of the memory in bytes */
+  std::uint32_t namesSize;  /*!< the size of the names in bytes */
+  std::uint32_t unused;
+  std::uint64_t code;       /*!< the offset of the code in the image */
+  std::uint64_t variables;  /*!< the offset of the variables */
+  std::uint64_t memory;     /*!< the offset of the memory */
+  std::uint64_t names;      /*!< the offset of the names */
+};
+
+/** A variable in an image */
+struct ImageVar {
+  std::uint32_t name;       /*!< the offset of its name in the names */
+  std::uint32_t offset;     /*!< its offset in memory */
+  std::uint32_t type;       /*!< its type (a typeName) */
+};
+
+/** An ahead-of-time backend, writing the code stored in a TargetCode, the
+ *  variables and the memory as an image (see ImageHeader).
+ */
+class ImageBackend {
+private:
+  TargetCode* code;
+  Memory& mem;
+  SymTbl* sym;
+  bool canonical;
+
+  // Stop the compiler from generating methods of copy the object
+  ImageBackend(ImageBackend const& copy);            // Not to be implemented
+  ImageBackend& operator=(ImageBackend const& copy); // Not to be implemented
+public:
+  /** Constructor; binds the backend to the code, to the memory holding
+   *  variables and temporaries, and to the symbol table naming the variables.
+   *  When canonical is set, the image runs with fractions kept reduced.
+   */
+  ImageBackend(TargetCode* code, Memory& mem, SymTbl* sym, bool canonical);
+
+  /** Prints out the image */
+  void emit(OutBuf& out);
+};
+
+/** An image mapped into memory, to be run in place.
+ *
+ *  The file is mapped privately and writable: the Interpreter runs the
+ *  instructions where they are, and the program writes its variables and
+ *  temporaries straight into the memory section (the kernel copies the
+ *  pages written to, and the file is left untouched). Nothing is copied out
+ *  of the image (the Interpreter only builds its dispatch table); loading
+ *  checks that every operand stays inside the image, so that a damaged file
+ *  can not make the program access any other memory.
+ */
+class Image {
+private:
+  char* base;
+  std::size_t size;
+  /* set when base was mapped by map(), rather than handed to use() */
+  bool mapped;
+
+  const ImageHeader* header;
+  const TacInstr* code;
+  const ImageVar* vars;
+  unsigned char* memory;
+  const char* names;
+
+  double seconds;
+
+  bool load(const char* name, std::ostream& err);
+  bool check(const char*& error) const;
+  bool checkOperand(const Operand& o, bool withInstr) const;
+
+  // Stop the compiler from generating methods of copy the object
+  Image(Image const& copy);            // Not to be implemented
+  Image& operator=(Image const& copy); // Not to be implemented
+public:
+  /** Bumped whenever the layout of images (or of TacInstr) changes */
+  static const std::uint32_t VERSION = 1;
+
+  /** The flag set in the header when fractions are kept reduced */
+  static const std::uint32_t CANONICAL = 1;
+
+  /** Constructor for an empty image */
+  Image();
+
+  /** Destructor; unmaps the image (if it was mapped by map()) */
+  ~Image();
+
+  /** Maps the image in the file at path into memory, and checks it.
+   *  Returns false (and prints out why on err) if it can not be run.
+   */
+  bool map(const char* path, std::ostream& err);
+
+  /** Uses the image of the given size already in memory at data (e.g. one
+   *  read from the Cache), and checks it as map() does. The program runs in
+   *  place, so data is written to; the image does not own it, and will not
+   *  release it. data must be aligned as a section of the image.
+   */
+  bool use(char* data, std::size_t size, std::ostream& err);
+
+  /** Runs the image with the Interpreter, and prints out the final value of
+   *  the variables, as --run does. Returns 0 on success.
+   */
+  int run(OutBuf& out, std::ostream& err);
+
+  /** Returns the wall time (in seconds) spent by the last map() or use() */
+  double getSeconds() const { return seconds; }
+};
+
+#endif //IMAGE_HPP_
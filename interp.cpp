@@ -0,0 +1,488 @@
+#include <iostream>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+#include <assert.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+#include "interp.hpp"
+
+/* Handlers, one per (operator, operand types) pair.
+ * The order must match the table of labels in Interpreter::execute().
+ */
+enum {
+  H_NOP,
+  H_HALT,
+  H_MOV4,   /* c = a (4 bytes, same type) */
+  H_MOV8,   /* c = a (8 bytes, a Fraction) */
+  H_I2F,    /* c = (float) a */
+  H_F2I,    /* c = floatToInt(a) */
+  H_Q2I,    /* c = a.num / a.denom */
+  H_I2Q,    /* c = a|1 */
+  H_ADDI, H_ADDF, H_ADDIF, H_ADDFI, H_ADDQ,
+  H_MULI, H_MULF, H_MULIF, H_MULFI, H_MULQ,
+  H_DIVI, H_DIVF, H_DIVIF, H_DIVFI, H_DIVQ,
+  H_LOADX,  /* c = a[b], with b computed at runtime */
+  H_STOREX, /* c[b] = a, with b computed at runtime */
+  H_JMP,
+  H_JEI, H_JEF, H_JEIF, H_JEFI, H_JEQ,
+  H_ADDQR, H_MULQR, H_DIVQR, /* as H_ADDQ, H_MULQ, H_DIVQ, then reduced */
+  H_BAD,
+  H_COUNT
+};
+
+/* Fraction kernels, working on the num/denom pair as a unit.
+ * They compute exactly what the operators of Fraction compute (products
+ * wrap around), but with SSE2 both halves are multiplied by one pmuludq,
+ * whose 64-bit products have the wrapped 32-bit ones as their low halves.
+ */
+#if defined(__SSE2__)
+static inline __m128i loadPair(const unsigned char* p) {
+  return _mm_loadl_epi64((const __m128i*)p);
+}
+
+static inline void storePair(unsigned char* p, __m128i x) {
+  _mm_storel_epi64((__m128i*)p, x);
+}
+
+/* (x0 * y0, x1 * y1) */
+static inline __m128i mulPairs(__m128i x, __m128i y) {
+  // pmuludq multiplies lanes 0 and 2: spread the pairs there first
+  __m128i p = _mm_mul_epu32(_mm_shuffle_epi32(x, _MM_SHUFFLE(1, 1, 0, 0)),
+                            _mm_shuffle_epi32(y, _MM_SHUFFLE(1, 1, 0, 0)));
+  return _mm_shuffle_epi32(p, _MM_SHUFFLE(3, 3, 2, 0));
+}
+
+static inline void addq(unsigned char* c, const unsigned char* a, const unsigned char* b) {
+  __m128i x = loadPair(a), y = loadPair(b);
+  // (x.num * y.denom, x.denom * y.denom) + (y.num * x.denom, 0)
+  __m128i p = mulPairs(x, _mm_shuffle_epi32(y, _MM_SHUFFLE(1, 1, 1, 1)));
+  __m128i q = mulPairs(y, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 1, 1, 1)));
+  storePair(c, _mm_add_epi32(p, _mm_and_si128(q, _mm_cvtsi32_si128(-1))));
+}
+
+static inline void mulq(unsigned char* c, const unsigned char* a, const unsigned char* b) {
+  storePair(c, mulPairs(loadPair(a), loadPair(b)));
+}
+
+static inline void divq(unsigned char* c, const unsigned char* a, const unsigned char* b) {
+  // (x.num * y.denom, x.denom * y.num)
+  storePair(c, mulPairs(loadPair(a), _mm_shuffle_epi32(loadPair(b), _MM_SHUFFLE(3, 2, 0, 1))));
+}
+#else
+static inline void addq(unsigned char* c, const unsigned char* a, const unsigned char* b) {
+  Fraction x, y;
+  memcpy(&x, a, 8);
+  memcpy(&y, b, 8);
+  x = x + y;
+  memcpy(c, &x, 8);
+}
+
+static inline void mulq(unsigned char* c, const unsigned char* a, const unsigned char* b) {
+  Fraction x, y;
+  memcpy(&x, a, 8);
+  memcpy(&y, b, 8);
+  x = x * y;
+  memcpy(c, &x, 8);
+}
+
+static inline void divq(unsigned char* c, const unsigned char* a, const unsigned char* b) {
+  Fraction x, y;
+  memcpy(&x, a, 8);
+  memcpy(&y, b, 8);
+  x = x / y;
+  memcpy(c, &x, 8);
+}
+#endif
+
+/* both halves of the fractions at a and b are equal */
+static inline bool eqq(const unsigned char* a, const unsigned char* b) {
+  uint64_t x, y;
+  memcpy(&x, a, 8);
+  memcpy(&y, b, 8);
+  return x == y;
+}
+
+Interpreter::Interpreter(TargetCode* code, Memory& mem, bool canonical)
+  : Interpreter(code->getCode(), code->getNextInstr(), (unsigned char*)mem.retrieve(0), canonical) {
+}
+
+Interpreter::Interpreter(const TacInstr* code, int length, unsigned char* storage, bool canonical)
+  : code(code), length(length), storage(storage), canonical(canonical), executed(0), seconds(0),
+    profile(nullptr) {
+}
+
+unsigned char* Interpreter::resolve(const Operand& o) {
+  switch (o.kind) {
+  case constOpd: {
+    // each constant gets its own 8-byte cell in the pool (room enough for a Fraction)
+    size_t off = constants.size();
+    assert(off + 8 <= constants.capacity());
+    constants.resize(off + 8, 0);
+    memcpy(&constants[off], &o.val, 4);
+    return &constants[off];
+  }
+  case varOpd:
+  case tempOpd:
+    return storage + o.val.i;
+  case instrOpd:
+    // the value of an instruction is the one stored in its temporary
+    return resolve(code[o.val.i].getTemp());
+  default:
+    return nullptr;
+  }
+}
+
+/** Picks the handler for a binary arithmetic operator, given the types of its operands.
+ *  The five handlers of each operator are laid out as: int, float, int-float, float-int, fraction.
+ */
+static int arithHandler(int base, typeName t1, typeName t2) {
+  if (t1 == intType && t2 == intType) return base;
+  if (t1 == floatType && t2 == floatType) return base + 1;
+  if (t1 == intType && t2 == floatType) return base + 2;
+  if (t1 == floatType && t2 == intType) return base + 3;
+  if (t1 == fracType && t2 == fracType) return base + 4;
+  return H_BAD;
+}
+
+void Interpreter::decode(const void* const* labels) {
+  const int n = length;
+
+  slots.assign(n, Slot());
+  // at most 3 constants per instruction; reserving up front keeps pointers stable
+  constants.clear();
+  constants.reserve(3 * 8 * (size_t)n);
+
+  for (int i = 0; i < n; i++) {
+    const TacInstr& instr = code[i];
+    Slot& s = slots[i];
+    int h = H_BAD;
+
+    s.a = s.b = s.c = nullptr;
+    s.target = nullptr;
+    s.vn = i;
+
+    Operand op1 = instr.getOperand1();
+    Operand op2 = instr.getOperand2();
+    Operand temp = instr.getTemp();
+
+    if ((instr.getOp() == jmpOpr || instr.getOp() == jeOpr) && (instr.getDest() < 0 || instr.getDest() >= n)) {
+      // a jump that was never backpatched: a runtime error when reached, as with the Jit
+      s.handler = labels[H_BAD];
+      continue;
+    }
+
+    switch (instr.getOp()) {
+    case fakeOpr:
+      h = H_NOP;
+      break;
+    case haltOpr:
+      h = H_HALT;
+      break;
+    case jmpOpr:
+      h = H_JMP;
+      break;
+    case jeOpr: {
+      h = arithHandler(H_JEI, op1.type, op2.type);
+      s.a = resolve(op1);
+      s.b = resolve(op2);
+    }
+      break;
+    case copyOpr:
+      if (op2.kind == noOpd) {
+        // "t(vn) = x": the value is just named, nothing to store
+        h = H_NOP;
+      } else {
+        typeName td = op1.type, ts = op2.type;
+        s.c = resolve(op1);
+        s.a = resolve(op2);
+        if (td == ts) {
+          h = (td == fracType) ? H_MOV8 : H_MOV4;
+        } else if (td == floatType && ts == intType) {
+          h = H_I2F;
+        } else if (td == intType && ts == floatType) {
+          h = H_F2I;
+        } else if (td == intType && ts == fracType) {
+          h = H_Q2I;
+        } else if (td == fracType && ts == intType) {
+          h = H_I2Q;
+        }
+      }
+      break;
+    case addOpr:
+    case mulOpr:
+    case divOpr: {
+      int base = instr.getOp() == addOpr ? H_ADDI : (instr.getOp() == mulOpr ? H_MULI : H_DIVI);
+      h = arithHandler(base, op1.type, op2.type);
+      if (canonical && h == base + 4) {
+        // the handlers that reduce their result come in the same order
+        h = H_ADDQR + (base - H_ADDI) / (H_MULI - H_ADDI);
+      }
+      s.a = resolve(op1);
+      s.b = resolve(op2);
+      s.c = resolve(temp);
+    }
+      break;
+    case offsetOpr: {
+      // temp = op1[op2]
+      s.c = resolve(temp);
+      if (op2.kind == constOpd && op2.type == intType) {
+        s.a = resolve(op1) + op2.val.i;
+        h = H_MOV4;
+      } else {
+        s.a = resolve(op1);
+        s.b = resolve(op2);
+        h = H_LOADX;
+      }
+    }
+      break;
+    case indexCopyOpr: {
+      // temp[op1] = op2
+      s.a = resolve(op2);
+      if (op1.kind == constOpd && op1.type == intType) {
+        s.c = resolve(temp) + op1.val.i;
+        h = H_MOV4;
+      } else {
+        s.c = resolve(temp);
+        s.b = resolve(op1);
+        h = H_STOREX;
+      }
+    }
+      break;
+    case condJmpOpr: /* TBD */
+    case UNKNOWNOpr:
+    default:
+      h = H_BAD;
+      break;
+    }
+
+    s.handler = labels[h];
+  }
+
+  // jump targets can only be resolved once all slots exist
+  for (int i = 0; i < n; i++) {
+    int dest = code[i].getDest();
+    if (dest >= 0 && dest < n) {
+      slots[i].target = &slots[dest];
+    }
+  }
+}
+
+/** Runs the decoded code. When profiling, the handlers also count each
+ *  instruction dispatched, and each jump taken, into the profile; the
+ *  checks are resolved at compile time, so the plain loop is not slowed down.
+ */
+template <bool profiling>
+int Interpreter::execute(ostream& err) {
+  static const void* const labels[H_COUNT] = {
+    &&nop, &&halt, &&mov4, &&mov8, &&i2f, &&f2i, &&q2i, &&i2q,
+    &&addi, &&addf, &&addif, &&addfi, &&addq,
+    &&muli, &&mulf, &&mulif, &&mulfi, &&mulq,
+    &&divi, &&divf, &&divif, &&divfi, &&divq,
+    &&loadx, &&storex, &&jmp,
+    &&jei, &&jef, &&jeif, &&jefi, &&jeq,
+    &&addqr, &&mulqr, &&divqr,
+    &&bad
+  };
+
+  decode(labels);
+
+  long long* counts = nullptr;
+  long long* taken = nullptr;
+  if (profiling) {
+    profile->counts.assign(length, 0);
+    profile->taken.assign(length, 0);
+    counts = profile->counts.data();
+    taken = profile->taken.data();
+  }
+
+  if (slots.empty()) {
+    return 0;
+  }
+
+  const char* error = nullptr;
+  long long count = 0;
+  Slot* pc = &slots[0];
+  auto start = chrono::steady_clock::now();
+
+  /* Operand access helpers */
+#define I(p) (*(int32_t*)(p))
+#define F(p) (*(float*)(p))
+#define Q(p) (*(Fraction*)(p))
+#define DISPATCH do { ++count; if (profiling) ++counts[pc->vn]; goto *pc->handler; } while (0)
+#define NEXT do { ++pc; DISPATCH; } while (0)
+#define JUMP(t) do { pc = (t); DISPATCH; } while (0)
+#define TAKEN(t) do { if (profiling) ++taken[pc->vn]; JUMP(t); } while (0)
+
+  --count;
+  JUMP(pc);
+
+ nop:
+  NEXT;
+ halt:
+  ++count;
+  goto done;
+ mov4:
+  memcpy(pc->c, pc->a, 4);
+  NEXT;
+ mov8:
+  memcpy(pc->c, pc->a, 8);
+  NEXT;
+ i2f:
+  F(pc->c) = (float)I(pc->a);
+  NEXT;
+ f2i:
+  I(pc->c) = floatToInt(F(pc->a));
+  NEXT;
+ q2i: {
+    int32_t x = Q(pc->a).num, y = Q(pc->a).denom;
+    if (y == 0 || (x == INT_MIN && y == -1)) {
+      error = "integer division by zero or overflow";
+      goto fail;
+    }
+    I(pc->c) = x / y;
+  }
+  NEXT;
+ i2q:
+  Q(pc->c) = Fraction(I(pc->a), 1);
+  NEXT;
+
+ addi:
+  I(pc->c) = wrapAdd(I(pc->a), I(pc->b));
+  NEXT;
+ addf:
+  F(pc->c) = F(pc->a) + F(pc->b);
+  NEXT;
+ addif:
+  F(pc->c) = (float)I(pc->a) + F(pc->b);
+  NEXT;
+ addfi:
+  F(pc->c) = F(pc->a) + (float)I(pc->b);
+  NEXT;
+ addq:
+  addq(pc->c, pc->a, pc->b);
+  NEXT;
+
+ muli:
+  I(pc->c) = wrapMul(I(pc->a), I(pc->b));
+  NEXT;
+ mulf:
+  F(pc->c) = F(pc->a) * F(pc->b);
+  NEXT;
+ mulif:
+  F(pc->c) = (float)I(pc->a) * F(pc->b);
+  NEXT;
+ mulfi:
+  F(pc->c) = F(pc->a) * (float)I(pc->b);
+  NEXT;
+ mulq:
+  mulq(pc->c, pc->a, pc->b);
+  NEXT;
+
+ divi: {
+    int32_t x = I(pc->a), y = I(pc->b);
+    if (y == 0 || (x == INT_MIN && y == -1)) {
+      error = "integer division by zero or overflow";
+      goto fail;
+    }
+    I(pc->c) = x / y;
+  }
+  NEXT;
+ divf:
+  F(pc->c) = F(pc->a) / F(pc->b);
+  NEXT;
+ divif:
+  F(pc->c) = (float)I(pc->a) / F(pc->b);
+  NEXT;
+ divfi:
+  F(pc->c) = F(pc->a) / (float)I(pc->b);
+  NEXT;
+ divq:
+  divq(pc->c, pc->a, pc->b);
+  NEXT;
+
+ loadx:
+  memcpy(pc->c, pc->a + I(pc->b), 4);
+  NEXT;
+ storex:
+  memcpy(pc->c + I(pc->b), pc->a, 4);
+  NEXT;
+
+ jmp:
+  TAKEN(pc->target);
+ jei:
+  if (I(pc->a) == I(pc->b)) TAKEN(pc->target);
+  NEXT;
+ jef:
+  if (F(pc->a) == F(pc->b)) TAKEN(pc->target);
+  NEXT;
+ jeif:
+  if ((float)I(pc->a) == F(pc->b)) TAKEN(pc->target);
+  NEXT;
+ jefi:
+  if (F(pc->a) == (float)I(pc->b)) TAKEN(pc->target);
+  NEXT;
+ jeq:
+  if (eqq(pc->a, pc->b)) TAKEN(pc->target);
+  NEXT;
+
+ addqr:
+  Q(pc->c) = reduce(Q(pc->a) + Q(pc->b));
+  NEXT;
+ mulqr:
+  Q(pc->c) = reduce(Q(pc->a) * Q(pc->b));
+  NEXT;
+ divqr:
+  Q(pc->c) = reduce(Q(pc->a) / Q(pc->b));
+  NEXT;
+
+ bad:
+  error = "unsupported instruction";
+ fail:
+  executed = count;
+  seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  err << "Runtime error: " << error << " at instruction " << pc->vn << endl;
+  return 1;
+
+ done:
+  executed = count;
+  seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  return 0;
+
+#undef I
+#undef F
+#undef Q
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef TAKEN
+}
+
+int Interpreter::run(ostream& err) {
+  executed = 0;
+  seconds = 0;
+
+  if (profile != nullptr) {
+    return execute<true>(err);
+  }
+  return execute<false>(err);
+}
+
+void Interpreter::setProfile(Profile* profile) {
+  this->profile = profile;
+}
+
+long long Interpreter::getExecuted() {
+  return executed;
+}
+
+double Interpreter::getSeconds() {
+  return seconds;
+}
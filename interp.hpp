@@ -0,0 +1,85 @@
+#ifndef INTERP_HPP_
+#define INTERP_HPP_
+
+/**
+ * @file interp.hpp
+ * @brief This header file contains the execution engine that
+ * runs the 3-addr code produced by tinycomp.
+ */
+
+#include <vector>
+#include "tinycomp.hpp"
+
+/** A direct-threaded interpreter for the code stored in a TargetCode
+ *  (or in a mapped Image).
+ *
+ *  Before running, each TacInstr is decoded once into a Slot, holding
+ *  the address of the handler that implements it (specialized on the
+ *  types of its operands) and the operands already resolved to pointers
+ *  into the Memory storage. Constants are placed in a small pool owned
+ *  by the interpreter, so that every operand is accessed the same way.
+ *  Dispatch jumps straight from one handler to the next (computed goto).
+ */
+class Interpreter {
+private:
+  /** A decoded instruction */
+  struct Slot {
+    const void* handler;
+    unsigned char* a;
+    unsigned char* b;
+    unsigned char* c;
+    Slot* target;
+    int vn;
+  };
+
+  const TacInstr* code;
+  int length;
+  unsigned char* storage;
+  bool canonical;
+
+  vector<Slot> slots;
+  vector<unsigned char> constants;
+
+  long long executed;
+  double seconds;
+
+  Profile* profile;
+
+  void decode(const void* const* labels);
+  template <bool profiling> int execute(std::ostream& err);
+
+  unsigned char* resolve(const Operand& o);
+public:
+  /** Constructor; binds the interpreter to the code to be run and to
+   *  the memory holding variables and temporaries. When canonical is set,
+   *  the result of each fraction operation is reduced (see reduce()).
+   */
+  Interpreter(TargetCode* code, Memory& mem, bool canonical);
+
+  /** Constructor; binds the interpreter to the length instructions at code,
+   *  whose variables and temporaries are stored at storage (as laid out by
+   *  Memory). This is how an Image is run in place.
+   */
+  Interpreter(const TacInstr* code, int length, unsigned char* storage, bool canonical);
+
+  /** Makes the next runs count how many times each instruction runs, and
+   *  each jump is taken, into profile (NULL to stop profiling). The counts
+   *  are kept by a copy of the dispatch loop of its own, so running without
+   *  a profile costs nothing more.
+   */
+  void setProfile(Profile* profile);
+
+  /** Runs the program until it executes a HALT.
+   *  Returns 0 on success, or a non-zero value if a runtime error occurred
+   *  (an error message is printed on err).
+   */
+  int run(std::ostream& err);
+
+  /** Returns the number of instructions executed by the last run() */
+  long long getExecuted();
+
+  /** Returns the wall time (in seconds) spent by the last run() */
+  double getSeconds();
+};
+
+#endif //INTERP_HPP_
@@ -0,0 +1,434 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+#include <assert.h>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+#include "jit.hpp"
+
+/* x86-64 registers, as numbered in the encoding */
+enum { EAX = 0, ECX = 1, EDX = 2, EBX = 3, ESI = 6, EDI = 7 };
+enum { XMM0 = 0, XMM1 = 1 };
+
+/* Status returned by the generated code: -1 after a HALT, or the valuenumber of
+ * the failing instruction (times 2) plus one of these errors.
+ */
+enum { E_DIV = 0, E_UNSUPPORTED = 1 };
+
+typedef int (*Entry)(unsigned char* base);
+
+/* A tiny assembler, appending to the code buffer.
+ * Memory operands are always [rbx + disp32], rbx holding the base of Memory.
+ */
+namespace {
+
+struct Asm {
+  vector<uint8_t>& b;
+
+  Asm(vector<uint8_t>& b) : b(b) {}
+
+  void byte(int x) { b.push_back((uint8_t)x); }
+  void bytes(int x, int y) { byte(x); byte(y); }
+  void bytes(int x, int y, int z) { byte(x); byte(y); byte(z); }
+  void dword(int32_t x) {
+    for (int k = 0; k < 4; k++) byte((x >> (8 * k)) & 0xff);
+  }
+
+  /* ModRM for [rbx + disp32] */
+  void mem(int reg, int32_t disp) { byte(0x80 | (reg << 3) | EBX); dword(disp); }
+  /* ModRM for a register to register operation */
+  void regs(int reg, int rm) { byte(0xc0 | (reg << 3) | rm); }
+
+  void movImm(int reg, int32_t imm) { byte(0xb8 + reg); dword(imm); }         // mov r32, imm32
+  void load(int reg, int32_t disp) { byte(0x8b); mem(reg, disp); }           // mov r32, [mem]
+  void store(int32_t disp, int reg) { byte(0x89); mem(reg, disp); }          // mov [mem], r32
+  void storeImm(int32_t disp, int32_t imm) { byte(0xc7); mem(0, disp); dword(imm); } // mov dword [mem], imm32
+  void load64(int reg, int32_t disp) { bytes(0x48, 0x8b); mem(reg, disp); }  // mov r64, [mem]
+  void store64(int32_t disp, int reg) { bytes(0x48, 0x89); mem(reg, disp); } // mov [mem], r64
+  void imulMem(int reg, int32_t disp) { bytes(0x0f, 0xaf); mem(reg, disp); } // imul r32, [mem]
+
+  void movss(int xmm, int32_t disp) { bytes(0xf3, 0x0f, 0x10); mem(xmm, disp); }      // movss xmm, [mem]
+  void storess(int32_t disp, int xmm) { bytes(0xf3, 0x0f, 0x11); mem(xmm, disp); }    // movss [mem], xmm
+  void movd(int xmm, int reg) { bytes(0x66, 0x0f, 0x6e); regs(xmm, reg); }           // movd xmm, r32
+  void cvtsi2ss(int xmm, int reg) { bytes(0xf3, 0x0f, 0x2a); regs(xmm, reg); }       // cvtsi2ss xmm, r32
+  void cvtsi2ssMem(int xmm, int32_t disp) { bytes(0xf3, 0x0f, 0x2a); mem(xmm, disp); } // cvtsi2ss xmm, [mem]
+  void cvttss2si(int reg, int xmm) { bytes(0xf3, 0x0f, 0x2c); regs(reg, xmm); }      // cvttss2si r32, xmm
+
+  /* jcc rel32 (or jmp, when cc is 0); returns the position of the displacement */
+  size_t jump(int cc) {
+    if (cc == 0) {
+      byte(0xe9);
+    } else {
+      bytes(0x0f, cc);
+    }
+    size_t pos = b.size();
+    dword(0);
+    return pos;
+  }
+
+  void patch(size_t pos, size_t target) {
+    int32_t rel = (int32_t)(target - (pos + 4));
+    memcpy(&b[pos], &rel, 4);
+  }
+
+  /* call a C function (all the registers but rbx are clobbered);
+   * rsp is kept aligned to 16 bytes by the push in the prologue */
+  void call(uint64_t (*fn)(int32_t, int32_t)) {
+    uint64_t x = (uint64_t)(uintptr_t)fn;
+    bytes(0x48, 0xb8);                                               // mov rax, imm64
+    for (int k = 0; k < 8; k++) byte((x >> (8 * k)) & 0xff);
+    bytes(0xff, 0xd0);                                               // call rax
+  }
+
+  /* return status from the generated function */
+  void leave(int32_t status) { movImm(EAX, status); byte(0x5b); byte(0xc3); } // mov eax, status; pop rbx; ret
+};
+
+}
+
+static const int JE = 0x84, JP = 0x8a;
+
+Jit::Jit(TargetCode* code, Memory& mem, bool canonical)
+  : code(code), mem(mem), canonical(canonical), exec(nullptr), execSize(0), seconds(0) {
+}
+
+Jit::~Jit() {
+  release();
+}
+
+void Jit::release() {
+#if defined(__x86_64__)
+  if (exec != nullptr) {
+    munmap(exec, execSize);
+  }
+#endif
+  exec = nullptr;
+  execSize = 0;
+}
+
+/** Returns the offset in memory of a variable, a temporary or the value of an instruction */
+static int32_t location(TargetCode* code, const Operand& o) {
+  if (o.kind == instrOpd) {
+    // the value of an instruction is the one stored in its temporary
+    return location(code, code->getInstr(o.val.i).getTemp());
+  }
+  assert(o.kind == varOpd || o.kind == tempOpd);
+  return o.val.i;
+}
+
+/** Loads an int operand into a register */
+static void loadInt(Asm& a, TargetCode* code, int reg, const Operand& o) {
+  if (o.kind == constOpd) {
+    a.movImm(reg, o.val.i);
+  } else {
+    a.load(reg, location(code, o));
+  }
+}
+
+/** Loads an int or float operand into an xmm register, as a float (eax is clobbered) */
+static void loadFloat(Asm& a, TargetCode* code, int xmm, const Operand& o) {
+  if (o.type == floatType) {
+    if (o.kind == constOpd) {
+      a.movImm(EAX, o.val.i);
+      a.movd(xmm, EAX);
+    } else {
+      a.movss(xmm, location(code, o));
+    }
+  } else {
+    if (o.kind == constOpd) {
+      a.movImm(EAX, o.val.i);
+      a.cvtsi2ss(xmm, EAX);
+    } else {
+      a.cvtsi2ssMem(xmm, location(code, o));
+    }
+  }
+}
+
+static bool isNumber(typeName t) {
+  return t == intType || t == floatType;
+}
+
+/** Returns the canonical form of num|denom, packed as it is stored in memory
+ *  (called by the generated code, which gets it in rax)
+ */
+static uint64_t reduceRegs(int32_t num, int32_t denom) {
+  Fraction x = reduce(Fraction(num, denom));
+  uint64_t r;
+  memcpy(&r, &x, sizeof(Fraction));
+  return r;
+}
+
+/** Divides eax by ecx, leaving through the error stub of instruction i
+ *  on a division by zero or an overflow
+ */
+static void divide(Asm& a, vector<pair<size_t, int> >& errors, int i) {
+  a.bytes(0x85, 0xc9);                                  // test ecx, ecx
+  errors.push_back(make_pair(a.jump(JE), 2 * i + E_DIV));
+  a.bytes(0x83, 0xf9, 0xff);                            // cmp ecx, -1
+  a.bytes(0x75, 0x0b);                                  // jne (over the next 2 instructions)
+  a.byte(0x3d); a.dword(INT32_MIN);                     // cmp eax, INT_MIN
+  errors.push_back(make_pair(a.jump(JE), 2 * i + E_DIV));
+  a.byte(0x99);                                         // cdq
+  a.bytes(0xf7, 0xf9);                                  // idiv ecx
+}
+
+/** Lowers the whole code into buf.
+ *  Returns false if the code can not be compiled on this platform.
+ */
+bool Jit::compile() {
+  const int n = code->getNextInstr();
+  Asm a(buf);
+
+  // the start of each instruction, and the jumps to be patched: (position, target)
+  vector<size_t> starts(n);
+  vector<pair<size_t, int> > jumps;
+  // the jumps to an error exit: (position, status)
+  vector<pair<size_t, int> > errors;
+
+  buf.clear();
+
+  // push rbx; mov rbx, rdi
+  a.byte(0x53);
+  a.bytes(0x48, 0x89, 0xfb);
+
+  for (int i = 0; i < n; i++) {
+    const TacInstr& instr = code->getInstr(i);
+    Operand op1 = instr.getOperand1(), op2 = instr.getOperand2(), temp = instr.getTemp();
+    bool ok = true;
+
+    starts[i] = buf.size();
+
+    if ((instr.getOp() == jmpOpr || instr.getOp() == jeOpr) && (instr.getDest() < 0 || instr.getDest() >= n)) {
+      // a jump that was never backpatched
+      a.leave(2 * i + E_UNSUPPORTED);
+      continue;
+    }
+
+    switch (instr.getOp()) {
+    case fakeOpr:
+      break;
+    case haltOpr:
+      a.leave(-1);
+      break;
+    case jmpOpr:
+      jumps.push_back(make_pair(a.jump(0), instr.getDest()));
+      break;
+    case copyOpr: {
+      if (op2.kind == noOpd) {
+        // "t(vn) = x": the value is just named, nothing to store
+        break;
+      }
+      int32_t dest = location(code, op1);
+      if (op1.type == op2.type && op1.type == fracType) {
+        a.load64(EAX, location(code, op2));
+        a.store64(dest, EAX);
+      } else if (op1.type == op2.type && isNumber(op1.type)) {
+        if (op2.kind == constOpd) {
+          a.storeImm(dest, op2.val.i);
+        } else {
+          a.load(EAX, location(code, op2));
+          a.store(dest, EAX);
+        }
+      } else if (op1.type == floatType && op2.type == intType) {
+        loadFloat(a, code, XMM0, op2);
+        a.storess(dest, XMM0);
+      } else if (op1.type == intType && op2.type == floatType) {
+        // a NaN or a value out of range gives INT32_MIN, as floatToInt() does
+        loadFloat(a, code, XMM0, op2);
+        a.cvttss2si(EAX, XMM0);
+        a.store(dest, EAX);
+      } else if (op1.type == intType && op2.type == fracType) {
+        int32_t src = location(code, op2);
+        a.load(EAX, src);
+        a.load(ECX, src + 4);
+        divide(a, errors, i);
+        a.store(dest, EAX);
+      } else if (op1.type == fracType && op2.type == intType) {
+        loadInt(a, code, EAX, op2);
+        a.store(dest, EAX);
+        a.storeImm(dest + 4, 1);
+      } else {
+        ok = false;
+      }
+    }
+      break;
+    case addOpr:
+    case mulOpr:
+    case divOpr: {
+      const oprEnum op = instr.getOp();
+      int32_t dest = location(code, temp);
+
+      if (op1.type == intType && op2.type == intType) {
+        loadInt(a, code, EAX, op1);
+        loadInt(a, code, ECX, op2);
+        if (op == addOpr) {
+          a.byte(0x01); a.regs(ECX, EAX);               // add eax, ecx
+        } else if (op == mulOpr) {
+          a.bytes(0x0f, 0xaf); a.regs(EAX, ECX);        // imul eax, ecx
+        } else {
+          divide(a, errors, i);
+        }
+        a.store(dest, EAX);
+      } else if (isNumber(op1.type) && isNumber(op2.type)) {
+        static const int ops[] = { 0x58, 0x59, 0x5e };  // addss, mulss, divss
+        loadFloat(a, code, XMM0, op1);
+        loadFloat(a, code, XMM1, op2);
+        a.bytes(0xf3, 0x0f, ops[op - addOpr]); a.regs(XMM0, XMM1);
+        a.storess(dest, XMM0);
+      } else if (op1.type == fracType && op2.type == fracType) {
+        // the same wrapping arithmetic as the Fraction operators
+        int32_t x = location(code, op1), y = location(code, op2);
+        if (op == addOpr) {
+          a.load(EAX, x); a.imulMem(EAX, y + 4);
+          a.load(ECX, y); a.imulMem(ECX, x + 4);
+          a.byte(0x01); a.regs(ECX, EAX);               // add eax, ecx
+          a.load(EDX, x + 4); a.imulMem(EDX, y + 4);
+        } else if (op == mulOpr) {
+          a.load(EAX, x); a.imulMem(EAX, y);
+          a.load(EDX, x + 4); a.imulMem(EDX, y + 4);
+        } else {
+          a.load(EAX, x); a.imulMem(EAX, y + 4);
+          a.load(EDX, x + 4); a.imulMem(EDX, y);
+        }
+        if (canonical) {
+          a.byte(0x89); a.regs(EAX, EDI);               // mov edi, eax
+          a.byte(0x89); a.regs(EDX, ESI);               // mov esi, edx
+          a.call(reduceRegs);
+          a.store64(dest, EAX);
+        } else {
+          a.store(dest, EAX);
+          a.store(dest + 4, EDX);
+        }
+      } else {
+        ok = false;
+      }
+    }
+      break;
+    case offsetOpr: {
+      // temp = op1[op2]
+      int32_t base = location(code, op1), dest = location(code, temp);
+      if (op2.kind == constOpd && op2.type == intType) {
+        a.load(EAX, base + op2.val.i);
+      } else {
+        loadInt(a, code, EAX, op2);
+        a.bytes(0x48, 0x63, 0xc0);                      // movsxd rax, eax
+        a.bytes(0x8b, 0x84, 0x03); a.dword(base);       // mov eax, [rbx + rax + base]
+      }
+      a.store(dest, EAX);
+    }
+      break;
+    case indexCopyOpr: {
+      // temp[op1] = op2
+      int32_t base = location(code, temp);
+      if (op1.kind == constOpd && op1.type == intType) {
+        if (op2.kind == constOpd) {
+          a.storeImm(base + op1.val.i, op2.val.i);
+        } else {
+          a.load(EAX, location(code, op2));
+          a.store(base + op1.val.i, EAX);
+        }
+      } else {
+        loadInt(a, code, EAX, op1);
+        a.bytes(0x48, 0x63, 0xc0);                      // movsxd rax, eax
+        loadInt(a, code, ECX, op2);
+        a.bytes(0x89, 0x8c, 0x03); a.dword(base);       // mov [rbx + rax + base], ecx
+      }
+    }
+      break;
+    case jeOpr:
+      if (op1.type == intType && op2.type == intType) {
+        loadInt(a, code, EAX, op1);
+        loadInt(a, code, ECX, op2);
+        a.byte(0x39); a.regs(ECX, EAX);                 // cmp eax, ecx
+        jumps.push_back(make_pair(a.jump(JE), instr.getDest()));
+      } else if (isNumber(op1.type) && isNumber(op2.type)) {
+        loadFloat(a, code, XMM0, op1);
+        loadFloat(a, code, XMM1, op2);
+        a.bytes(0x0f, 0x2e); a.regs(XMM0, XMM1);        // ucomiss xmm0, xmm1
+        a.bytes(0x7a, 0x06);                            // jp (unordered: not equal)
+        jumps.push_back(make_pair(a.jump(JE), instr.getDest()));
+      } else if (op1.type == fracType && op2.type == fracType) {
+        a.load64(EAX, location(code, op1));
+        a.bytes(0x48, 0x3b); a.mem(EAX, location(code, op2)); // cmp rax, [mem]
+        jumps.push_back(make_pair(a.jump(JE), instr.getDest()));
+      } else {
+        ok = false;
+      }
+      break;
+    case condJmpOpr: /* TBD */
+    case UNKNOWNOpr:
+    default:
+      ok = false;
+      break;
+    }
+
+    if (!ok) {
+      a.leave(2 * i + E_UNSUPPORTED);
+    }
+  }
+
+  for (size_t k = 0; k < jumps.size(); k++) {
+    a.patch(jumps[k].first, starts[jumps[k].second]);
+  }
+  for (size_t k = 0; k < errors.size(); k++) {
+    a.patch(errors[k].first, buf.size());
+    a.leave(errors[k].second);
+  }
+
+#if defined(__x86_64__)
+  execSize = buf.size();
+  exec = mmap(nullptr, execSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (exec == MAP_FAILED) {
+    exec = nullptr;
+    return false;
+  }
+  memcpy(exec, buf.data(), execSize);
+  if (mprotect(exec, execSize, PROT_READ | PROT_EXEC) != 0) {
+    release();
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+int Jit::run(ostream& err) {
+  seconds = 0;
+  release();
+
+  if (code->getNextInstr() == 0) {
+    return 0;
+  }
+
+  if (!compile()) {
+    err << "JIT error: native code can not be generated on this platform" << endl;
+    return 1;
+  }
+
+  Entry entry = (Entry)exec;
+  auto start = chrono::steady_clock::now();
+  int status = entry((unsigned char*)mem.retrieve(0));
+  seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  if (status >= 0) {
+    const char* error = (status % 2 == E_DIV) ? "integer division by zero or overflow" : "unsupported instruction";
+    err << "Runtime error: " << error << " at instruction " << status / 2 << endl;
+    return 1;
+  }
+  return 0;
+}
+
+size_t Jit::getCodeSize() {
+  return buf.size();
+}
+
+double Jit::getSeconds() {
+  return seconds;
+}
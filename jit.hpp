@@ -0,0 +1,69 @@
+#ifndef JIT_HPP_
+#define JIT_HPP_
+
+/**
+ * @file jit.hpp
+ * @brief This header file contains the native backend that compiles
+ * the 3-addr code produced by tinycomp to x86-64 machine code.
+ */
+
+#include <vector>
+#include <cstdint>
+#include "tinycomp.hpp"
+
+/** A just-in-time compiler for the code stored in a TargetCode.
+ *
+ *  Each TacInstr is lowered to a short sequence of x86-64 instructions,
+ *  specialized on the types of its operands as the Interpreter does.
+ *  Variables and temporaries become accesses at a fixed displacement from
+ *  the base of the Memory storage, which is kept in a register; constants
+ *  become immediates. Jumps become native branches, patched once all the
+ *  instructions have been placed. The machine code is copied into an
+ *  executable buffer obtained with mmap, and called as a function.
+ *
+ *  The JIT is only available on x86-64; elsewhere, run() fails.
+ */
+class Jit {
+private:
+  TargetCode* code;
+  Memory& mem;
+  bool canonical;
+
+  /* the machine code, as it is generated */
+  std::vector<std::uint8_t> buf;
+  /* the executable copy of buf */
+  void* exec;
+  std::size_t execSize;
+
+  double seconds;
+
+  bool compile();
+  void release();
+
+  // Stop the compiler from generating methods of copy the object
+  Jit(Jit const& copy);            // Not to be implemented
+  Jit& operator=(Jit const& copy); // Not to be implemented
+public:
+  /** Constructor; binds the JIT to the code to be run and to
+   *  the memory holding variables and temporaries. When canonical is set,
+   *  the result of each fraction operation is reduced (see reduce()).
+   */
+  Jit(TargetCode* code, Memory& mem, bool canonical);
+
+  /** Destructor; gives the executable buffer back to the system */
+  ~Jit();
+
+  /** Compiles the program and runs it until it executes a HALT.
+   *  Returns 0 on success, or a non-zero value if the program can not be
+   *  compiled or a runtime error occurred (an error message is printed on err).
+   */
+  int run(std::ostream& err);
+
+  /** Returns the size (in bytes) of the machine code generated by the last run() */
+  std::size_t getCodeSize();
+
+  /** Returns the wall time (in seconds) spent running the machine code by the last run() */
+  double getSeconds();
+};
+
+#endif //JIT_HPP_
@@ -0,0 +1,350 @@
+#include <iostream>
+#include <algorithm>
+#include <queue>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "liveness.hpp"
+
+/* A set of words of temporaries, as a bit vector */
+typedef vector<uint64_t> WordSet;
+
+static void insert(WordSet& s, int w) {
+  s[w >> 6] |= (uint64_t)1 << (w & 63);
+}
+
+Liveness::Liveness(TargetCode* code, Memory& mem) : code(code), mem(mem), used(0), before(0), after(0), slots(0) {
+}
+
+/** Returns the index of the word of a temporary at offset, or -1 if it belongs to a variable */
+int Liveness::word(int offset) {
+  unordered_map<int, int>::iterator it = owner.find(offset);
+
+  return (it != owner.end()) ? it->second : -1;
+}
+
+/** Fills uses with the words of temporaries read by instruction i, and defs with
+ *  the words it writes. Returns false if the accessed words can not be bounded.
+ */
+bool Liveness::access(int i, vector<int>& uses, vector<int>& defs) {
+  const TacInstr& instr = code->getInstr(i);
+  const oprEnum op = instr.getOp();
+  Operand o[3] = { instr.getOperand1(), instr.getOperand2(), instr.getTemp() };
+
+  uses.clear();
+  defs.clear();
+
+  if (op == jmpOpr || op == haltOpr || op == fakeOpr || (op == copyOpr && o[1].kind == noOpd)) {
+    return true;
+  }
+
+  // the location of each operand (the temporary of an instruction, for an instruction)
+  int loc[3];
+  for (int k = 0; k < 3; k++) {
+    Operand x = o[k];
+    if (x.kind == instrOpd && !(k == 2 && op == jeOpr)) {
+      x = code->getInstr(x.val.i).getTemp();
+    }
+    loc[k] = (x.kind == tempOpd || x.kind == varOpd) ? x.val.i : -1;
+  }
+
+  // reads
+  for (int k = (op == copyOpr) ? 1 : 0; k < 2; k++) {
+    if (loc[k] < 0) {
+      continue;
+    }
+    int from = loc[k], to = loc[k] + Type::width(o[k].type);
+    if (op == offsetOpr && k == 0) {
+      if (o[1].kind != constOpd) {
+        return false;
+      }
+      from = loc[k] + o[1].val.i;
+      to = from + 4;
+    }
+    for (int off = from; off < to; off += 4) {
+      if (word(off) >= 0) uses.push_back(word(off));
+    }
+  }
+
+  // writes
+  int dest = (op == copyOpr) ? 0 : 2;
+  if (op == jeOpr || loc[dest] < 0) {
+    return true;
+  }
+  int from = loc[dest], to = loc[dest] + Type::width(o[dest].type);
+  if (op == offsetOpr) {
+    to = from + 4;
+  } else if (op == indexCopyOpr) {
+    if (o[0].kind != constOpd) {
+      return false;
+    }
+    from = loc[dest] + o[0].val.i;
+    to = from + 4;
+  }
+  for (int off = from; off < to; off += 4) {
+    if (word(off) >= 0) defs.push_back(word(off));
+  }
+  return true;
+}
+
+/** Computes the live range of every temporary.
+ *  Returns false if the code accesses memory in a way that can not be analyzed.
+ *
+ *  Most temporaries are written and read in the same block; only the words
+ *  read in a block before being written there can be live across blocks, so
+ *  the dataflow is run over these words alone.
+ */
+bool Liveness::analyze() {
+  const int n = code->getNextInstr();
+  const int words = wordTemp.size();
+
+  vector<bool> leader;
+  code->findLeaders(leader);
+
+  vector<int> starts;
+  vector<int> blockOf(n);
+  for (int i = 0; i < n; i++) {
+    if (leader[i]) {
+      starts.push_back(i);
+    }
+    blockOf[i] = starts.size() - 1;
+  }
+  starts.push_back(n);
+  const int blocks = starts.size() - 1;
+
+  // upward exposed uses of each block, and the words defined by each block
+  vector<vector<int> > useList(blocks), defList(blocks);
+  // the last block that used (defined) each word
+  vector<int> usedIn(words, -1), definedIn(words, -1);
+  vector<int> uses, defs;
+
+  for (int b = 0; b < blocks; b++) {
+    for (int i = starts[b]; i < starts[b+1]; i++) {
+      if (!access(i, uses, defs)) {
+        return false;
+      }
+      for (size_t k = 0; k < uses.size(); k++) {
+        const int w = uses[k];
+        if (definedIn[w] != b && usedIn[w] != b) {
+          usedIn[w] = b;
+          useList[b].push_back(w);
+        }
+      }
+      for (size_t k = 0; k < defs.size(); k++) {
+        const int w = defs[k];
+        if (definedIn[w] != b) {
+          definedIn[w] = b;
+          defList[b].push_back(w);
+        }
+      }
+
+      // every access is part of the live range of the temporary
+      for (size_t k = 0; k < uses.size(); k++) {
+        extend(wordTemp[uses[k]], i);
+      }
+      for (size_t k = 0; k < defs.size(); k++) {
+        extend(wordTemp[defs[k]], i);
+      }
+    }
+  }
+
+  // the words that can be live across blocks, numbered densely
+  vector<int> global(words, -1);
+  vector<int> globalWord;
+  for (int b = 0; b < blocks; b++) {
+    for (size_t k = 0; k < useList[b].size(); k++) {
+      const int w = useList[b][k];
+      if (global[w] < 0) {
+        global[w] = globalWord.size();
+        globalWord.push_back(w);
+      }
+    }
+  }
+  if (globalWord.empty()) {
+    return true;
+  }
+  const size_t setSize = (globalWord.size() + 63) / 64;
+
+  vector<WordSet> use(blocks, WordSet(setSize)), def(blocks, WordSet(setSize));
+  for (int b = 0; b < blocks; b++) {
+    for (size_t k = 0; k < useList[b].size(); k++) {
+      insert(use[b], global[useList[b][k]]);
+    }
+    for (size_t k = 0; k < defList[b].size(); k++) {
+      if (global[defList[b][k]] >= 0) insert(def[b], global[defList[b][k]]);
+    }
+  }
+
+  // successors of each block
+  vector<int> succ1(blocks, -1), succ2(blocks, -1);
+  for (int b = 0; b < blocks; b++) {
+    const TacInstr& last = code->getInstr(starts[b+1] - 1);
+    switch (last.getOp()) {
+    case haltOpr:
+      break;
+    case jmpOpr:
+      succ1[b] = blockOf[last.getDest()];
+      break;
+    case jeOpr:
+    case condJmpOpr:
+      succ1[b] = blockOf[last.getDest()];
+      if (b + 1 < blocks) succ2[b] = b + 1;
+      break;
+    default:
+      if (b + 1 < blocks) succ1[b] = b + 1;
+      break;
+    }
+  }
+
+  // liveIn = use U (liveOut - def), iterated backwards until nothing changes
+  vector<WordSet> liveIn(blocks, WordSet(setSize)), liveOut(blocks, WordSet(setSize));
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int b = blocks - 1; b >= 0; b--) {
+      for (size_t k = 0; k < setSize; k++) {
+        uint64_t out = 0;
+        if (succ1[b] >= 0) out |= liveIn[succ1[b]][k];
+        if (succ2[b] >= 0) out |= liveIn[succ2[b]][k];
+        uint64_t in = use[b][k] | (out & ~def[b][k]);
+        if (in != liveIn[b][k] || out != liveOut[b][k]) {
+          changed = true;
+        }
+        liveIn[b][k] = in;
+        liveOut[b][k] = out;
+      }
+    }
+  }
+
+  // a word live on entry to (exit from) a block is live at its first (last) instruction
+  for (int b = 0; b < blocks; b++) {
+    for (size_t k = 0; k < setSize; k++) {
+      for (uint64_t in = liveIn[b][k]; in != 0; in &= in - 1) {
+        extend(wordTemp[globalWord[k * 64 + __builtin_ctzll(in)]], starts[b]);
+      }
+      for (uint64_t out = liveOut[b][k]; out != 0; out &= out - 1) {
+        extend(wordTemp[globalWord[k * 64 + __builtin_ctzll(out)]], starts[b+1] - 1);
+      }
+    }
+  }
+
+  return true;
+}
+
+/** Extends the live range of temporary t to include instruction i */
+void Liveness::extend(int t, int i) {
+  if (temps[t].first < 0 || i < temps[t].first) {
+    temps[t].first = i;
+  }
+  if (i > temps[t].last) {
+    temps[t].last = i;
+  }
+}
+
+/** Assigns a location to every temporary that is used, by a linear scan over
+ *  the live ranges; a location is given back once the range it holds is over.
+ *  Fills moved with the new offset of each temporary, indexed by its old offset.
+ */
+void Liveness::allocate(unordered_map<int, int>& moved) {
+  const int base = temps.empty() ? 0 : temps[0].offset;
+
+  vector<int> order;
+  for (size_t t = 0; t < temps.size(); t++) {
+    if (temps[t].first >= 0) {
+      order.push_back(t);
+    }
+  }
+  stable_sort(order.begin(), order.end(), [this](int x, int y) { return temps[x].first < temps[y].first; });
+
+  // the ranges still holding a location, by their end: (last, temporary)
+  priority_queue<pair<int, int>, vector<pair<int, int> >, greater<pair<int, int> > > active;
+  // free locations, for temporaries of 4 and 8 bytes
+  vector<int> free[2];
+  int top = base;
+
+  for (size_t k = 0; k < order.size(); k++) {
+    const Temp& t = temps[order[k]];
+
+    while (!active.empty() && active.top().first < t.first) {
+      const Temp& done = temps[active.top().second];
+      free[done.width == 4 ? 0 : 1].push_back(moved[done.offset]);
+      active.pop();
+    }
+
+    vector<int>& pool = free[t.width == 4 ? 0 : 1];
+    if (!pool.empty()) {
+      moved[t.offset] = pool.back();
+      pool.pop_back();
+    } else {
+      // a new location, aligned as Memory does
+      top = (top + t.width - 1) & ~(t.width - 1);
+      moved[t.offset] = top;
+      top += t.width;
+      slots++;
+    }
+    used++;
+    active.push(make_pair(t.last, order[k]));
+  }
+
+  after = top - base;
+}
+
+int Liveness::run() {
+  const list<TempAddress*>& all = mem.getTemporaries();
+
+  temps.clear();
+  owner.clear();
+  wordTemp.clear();
+  used = before = after = slots = 0;
+
+  for (list<TempAddress*>::const_iterator it = all.begin(); it != all.end(); ++it) {
+    Temp t;
+    t.offset = (*it)->getOffset();
+    t.width = Type::width((*it)->getType());
+    t.first = t.last = -1;
+
+    for (int off = t.offset; off < t.offset + t.width; off += 4) {
+      owner[off] = wordTemp.size();
+      wordTemp.push_back(temps.size());
+    }
+    temps.push_back(t);
+    before += t.width;
+  }
+
+  if (temps.empty() || !analyze()) {
+    used = slots = temps.size();
+    after = before;
+    return 0;
+  }
+
+  unordered_map<int, int> moved;
+  allocate(moved);
+
+  // rewrite the code with the new locations
+  const int n = code->getNextInstr();
+  for (int i = 0; i < n; i++) {
+    TacInstr& instr = code->getInstr(i);
+    Operand o[3] = { instr.getOperand1(), instr.getOperand2(), instr.getTemp() };
+
+    for (int k = 0; k < 3; k++) {
+      if (o[k].kind == tempOpd) {
+        assert(moved.find(o[k].val.i) != moved.end());
+        o[k].val.i = moved[o[k].val.i];
+      }
+    }
+    instr.setOperand1(o[0]);
+    instr.setOperand2(o[1]);
+    instr.setTemp(o[2]);
+  }
+
+  mem.relocateTemps(moved, temps[0].offset + after);
+
+  return before - after;
+}
+
+void Liveness::printOut(OutBuf& out) const {
+  out << used << " temporaries in " << slots << " locations, "
+      << after << " bytes (" << before << " bytes without reuse)\n";
+}
@@ -0,0 +1,69 @@
+#ifndef LIVENESS_HPP_
+#define LIVENESS_HPP_
+
+/**
+ * @file liveness.hpp
+ * @brief This header file contains the liveness analysis that lets
+ * temporaries share memory.
+ */
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "tinycomp.hpp"
+
+/** Liveness analysis of the temporaries used by a TargetCode, and reuse of their memory.
+ *
+ *  Liveness is computed on the basic blocks of the code for each 4-byte
+ *  word of every temporary, since the two halves of a fraction are written
+ *  separately. The live range of a temporary spans all the instructions
+ *  where one of its words is live or accessed; temporaries of the same
+ *  width whose live ranges do not overlap are then packed in the same
+ *  location of Memory (by a linear scan over the ranges), and the code is
+ *  rewritten to use the new locations.
+ */
+class Liveness {
+private:
+  /** A temporary, with its live range */
+  struct Temp {
+    int offset;
+    int width;
+    int first, last;
+  };
+
+  TargetCode* code;
+  Memory& mem;
+
+  std::vector<Temp> temps;
+  /* the index of each word of a temporary, by offset */
+  std::unordered_map<int, int> owner;
+  /* the temporary each word belongs to */
+  std::vector<int> wordTemp;
+
+  /* temporaries used by the code */
+  int used;
+  /* bytes taken by the temporaries, before and after reuse */
+  int before;
+  int after;
+  /* locations shared by the temporaries */
+  int slots;
+
+  int word(int offset);
+  bool access(int i, std::vector<int>& uses, std::vector<int>& defs);
+  bool analyze();
+  void extend(int t, int i);
+  void allocate(std::unordered_map<int, int>& moved);
+public:
+  /** Constructor; binds the analysis to the code and to the memory holding its temporaries */
+  Liveness(TargetCode* code, Memory& mem);
+
+  /** Runs the analysis, and moves the temporaries to their shared locations.
+   *  Returns the number of bytes saved.
+   */
+  int run();
+
+  /** Prints out how much memory the temporaries take, before and after reuse */
+  void printOut(OutBuf& out) const;
+};
+
+#endif //LIVENESS_HPP_
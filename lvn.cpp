@@ -0,0 +1,490 @@
+#include <iostream>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "lvn.hpp"
+
+/* Kinds of value expressions, besides the operators (see ValueNumbering::Key).
+ * Operators are numbered together with the types of their operands.
+ */
+enum {
+  K_CONST = 0x10000,    /* a constant: type, payload */
+  K_CONV,               /* a copy converting a value: type, value */
+  K_PAIR,               /* a fraction, given the values of its two words */
+  K_PART                /* a word of a fraction: value, index of the word */
+};
+
+static int width(typeName type) {
+  return Type::width(type);
+}
+
+size_t ValueNumbering::KeyHash::operator()(const Key& k) const {
+  size_t h = (size_t)k.op;
+  h = h * 0x9e3779b1u + (size_t)k.a;
+  h = h * 0x9e3779b1u + (size_t)k.b;
+  h = h * 0x9e3779b1u + (size_t)k.c;
+  return h;
+}
+
+ValueNumbering::ValueNumbering(TargetCode* code) : code(code), counter(0), opaque(false), blockStart(0), blockEnd(0), removed(0) {
+}
+
+/** Returns the value number of an expression, giving it a new one the first time it is seen */
+int ValueNumbering::number(int op, int a, int b, int c) {
+  Key k = { op, a, b, c };
+  unordered_map<Key, int, KeyHash>::iterator it = table.find(k);
+
+  if (it != table.end()) {
+    return it->second;
+  }
+  table[k] = counter;
+  return counter++;
+}
+
+/** Returns the value number of the word at offset; a word that was not written
+ *  in the current block holds an unknown value, which gets a number of its own.
+ */
+int ValueNumbering::word(int offset) {
+  unordered_map<int, int>::iterator it = words.find(offset);
+
+  if (it != words.end()) {
+    return it->second;
+  }
+  words[offset] = counter;
+  return counter++;
+}
+
+/** Returns the offset in memory an operand refers to (-1 for constants and empty operands) */
+int ValueNumbering::location(const Operand& o) {
+  switch (o.kind) {
+  case varOpd:
+  case tempOpd:
+    return o.val.i;
+  case instrOpd:
+    // the value of an instruction is the one stored in its temporary
+    return location(code->getInstr(o.val.i).getTemp());
+  default:
+    return -1;
+  }
+}
+
+/** Returns the value number of the value of the given type stored at offset */
+int ValueNumbering::valueAt(int offset, typeName type) {
+  if (width(type) == 4) {
+    return word(offset);
+  }
+
+  int w0 = word(offset), w1 = word(offset + 4);
+  int vn = number(K_PAIR, w0, w1, 0);
+  parts[vn] = make_pair(w0, w1);
+  return vn;
+}
+
+/** Returns the value number of the value of an operand */
+int ValueNumbering::valueOf(const Operand& o) {
+  if (o.kind == constOpd) {
+    int vn = number(K_CONST, o.type, o.val.i, 0);
+    constants[vn] = o;
+    return vn;
+  }
+  return valueAt(location(o), o.type);
+}
+
+/** Records that the value vn, of the given type, is now stored at offset */
+void ValueNumbering::store(int i, int offset, typeName type, int vn) {
+  if (width(type) == 4) {
+    words[offset] = vn;
+    firstDefs.insert(make_pair(offset, i));
+    return;
+  }
+
+  if (parts.find(vn) == parts.end()) {
+    // a fraction computed by an instruction: its words get a number of their own
+    int w0 = number(K_PART, vn, 0, 0), w1 = number(K_PART, vn, 1, 0);
+    table[Key{ K_PAIR, w0, w1, 0 }] = vn;
+    parts[vn] = make_pair(w0, w1);
+  }
+  words[offset] = parts[vn].first;
+  words[offset + 4] = parts[vn].second;
+  firstDefs.insert(make_pair(offset, i));
+  firstDefs.insert(make_pair(offset + 4, i));
+}
+
+/** Returns true if loc (a location or a constant) still holds the value vn */
+bool ValueNumbering::isHeld(const Operand& loc, int vn) {
+  if (loc.kind == constOpd) {
+    return true;
+  }
+  return valueAt(location(loc), loc.type) == vn;
+}
+
+/** Fills acc with the memory read by instruction i, and returns how many
+ *  operands are read. An access of unknown extent has width -1.
+ */
+int ValueNumbering::reads(int i, Access acc[3]) {
+  const TacInstr& instr = code->getInstr(i);
+  Operand o[3] = { instr.getOperand1(), instr.getOperand2(), instr.getTemp() };
+  int n = 0;
+
+  for (int k = 0; k < 2; k++) {
+    bool read;
+    switch (instr.getOp()) {
+    case copyOpr:
+      read = (k == 1);
+      break;
+    case addOpr:
+    case mulOpr:
+    case divOpr:
+    case offsetOpr:
+    case indexCopyOpr:
+    case jeOpr:
+      read = true;
+      break;
+    default:
+      read = false;
+      break;
+    }
+
+    int loc = location(o[k]);
+    if (!read || loc < 0) {
+      continue;
+    }
+
+    Access& a = acc[n++];
+    a.slot = k;
+    a.loc = loc;
+    a.offset = loc;
+    a.width = width(o[k].type);
+
+    if (instr.getOp() == offsetOpr && k == 0) {
+      // only one word of the base is read
+      if (o[1].kind == constOpd) {
+        a.offset = loc + o[1].val.i;
+        a.width = 4;
+      } else {
+        a.width = -1;
+      }
+    }
+  }
+  return n;
+}
+
+/** Fills acc with the memory written by instruction i, if any.
+ *  A write of unknown extent has width -1.
+ */
+bool ValueNumbering::writes(int i, Access& acc) {
+  const TacInstr& instr = code->getInstr(i);
+  Operand dest;
+
+  switch (instr.getOp()) {
+  case copyOpr:
+    if (instr.getOperand2().kind == noOpd) {
+      return false;
+    }
+    dest = instr.getOperand1();
+    acc.slot = 0;
+    break;
+  case addOpr:
+  case mulOpr:
+  case divOpr:
+  case offsetOpr:
+  case indexCopyOpr:
+    dest = instr.getTemp();
+    acc.slot = 2;
+    break;
+  default:
+    return false;
+  }
+
+  acc.loc = acc.offset = location(dest);
+  acc.width = width(dest.type);
+
+  if (instr.getOp() == offsetOpr) {
+    acc.width = 4;
+  } else if (instr.getOp() == indexCopyOpr) {
+    // only one word of the destination is written
+    Operand index = instr.getOperand1();
+    if (index.kind == constOpd) {
+      acc.offset += index.val.i;
+      acc.width = 4;
+    } else {
+      acc.width = -1;
+    }
+  }
+  return true;
+}
+
+static bool overlaps(int o1, int w1, int o2, int w2) {
+  return w1 < 0 || w2 < 0 || (o1 < o2 + w2 && o2 < o1 + w1);
+}
+
+/** Tries to remove instruction i, which stores into the temporary dest a value
+ *  that loc already holds: the uses of dest that follow are rewritten to use loc.
+ *  This is only possible when dest is not read outside the current block, and
+ *  when loc keeps its value until the last of those uses.
+ *  Returns true if the instruction can be (and has been) removed.
+ */
+bool ValueNumbering::replace(int i, const Operand& dest, const Operand& loc) {
+  const int off = location(dest), w = width(dest.type);
+  const int lloc = location(loc), lw = (lloc < 0) ? 0 : width(loc.type);
+  int last = -1;
+
+  if (opaque || (lloc >= 0 && overlaps(off, w, lloc, lw))) {
+    return false;
+  }
+
+  // all the reads of dest must lie in this block, after its first definition there
+  for (int o = off; o < off + w; o += 4) {
+    unordered_map<int, Range>::iterator r = readRange.find(o);
+    if (r == readRange.end()) {
+      continue;
+    }
+
+    unordered_map<int, int>::iterator d = firstDefs.find(o);
+    int def = (d != firstDefs.end()) ? d->second : i;
+
+    if (r->second.first <= def || r->second.last >= blockEnd) {
+      return false;
+    }
+    last = max(last, r->second.last);
+  }
+
+  vector<pair<int, int> > uses;
+  bool killed = false;
+
+  for (int j = i + 1; j <= last; j++) {
+    if (dead[j]) {
+      continue;
+    }
+
+    Access acc[3];
+    int n = reads(j, acc);
+    for (int k = 0; k < n; k++) {
+      if (!overlaps(acc[k].offset, acc[k].width, off, w)) {
+        continue;
+      }
+      // dest can only be replaced where it is used as a whole (or as the base of a load)
+      if (acc[k].loc != off || acc[k].width < 0 || killed) {
+        return false;
+      }
+      if (lloc < 0 && code->getInstr(j).getOp() == offsetOpr && acc[k].slot == 0) {
+        return false;
+      }
+      uses.push_back(make_pair(j, acc[k].slot));
+    }
+
+    Access wr;
+    if (writes(j, wr)) {
+      if (lloc >= 0 && overlaps(wr.offset, wr.width, lloc, lw)) {
+        killed = true;
+      }
+      if (overlaps(wr.offset, wr.width, off, w)) {
+        // a new value for dest: the later uses do not refer to this one
+        if (wr.offset == off && wr.width == w && wr.loc == off) {
+          break;
+        }
+        return false;
+      }
+    }
+  }
+
+  for (size_t u = 0; u < uses.size(); u++) {
+    TacInstr& instr = code->getInstr(uses[u].first);
+    Operand o = (uses[u].second == 0) ? instr.getOperand1() : instr.getOperand2();
+    Operand r = loc;
+
+    r.type = o.type;
+    if (uses[u].second == 0) {
+      instr.setOperand1(r);
+    } else {
+      instr.setOperand2(r);
+    }
+
+    // loc is now read by this instruction, too
+    for (int o2 = lloc; lloc >= 0 && o2 < lloc + lw; o2 += 4) {
+      Range& range = readRange[o2];
+      if (range.first < 0 || uses[u].first < range.first) range.first = uses[u].first;
+      if (uses[u].first > range.last) range.last = uses[u].first;
+    }
+  }
+
+  return true;
+}
+
+/** Redirects every operand referring to the value of instruction i to loc */
+void ValueNumbering::redirect(int i, const Operand& loc) {
+  unordered_map<int, vector<pair<int, int> > >::iterator r = refs.find(i);
+
+  if (r == refs.end()) {
+    return;
+  }
+
+  for (size_t k = 0; k < r->second.size(); k++) {
+    TacInstr& instr = code->getInstr(r->second[k].first);
+    Operand o = (r->second[k].second == 0) ? instr.getOperand1() : instr.getOperand2();
+
+    // the operand may have been rewritten in the meantime
+    if (o.kind != instrOpd || o.val.i != i) {
+      continue;
+    }
+    if (r->second[k].second == 0) {
+      instr.setOperand1(Operand(loc.kind, o.type, loc.val.i));
+    } else {
+      instr.setOperand2(Operand(loc.kind, o.type, loc.val.i));
+    }
+  }
+}
+
+/** Numbers the value computed by instruction i, which stores it into dest.
+ *  The instruction is removed when it is redundant.
+ */
+void ValueNumbering::define(int i, const Operand& dest, int vn) {
+  const int off = location(dest);
+  // the location of dest, named as a variable or a temporary
+  const Operand named(dest.kind == instrOpd ? tempOpd : dest.kind, dest.type, off);
+
+  if (valueAt(off, dest.type) == vn) {
+    // dest already holds the value
+    dead[i] = true;
+    redirect(i, named);
+    removed++;
+    return;
+  }
+
+  unordered_map<int, Operand>::iterator h = holders.find(vn);
+  bool held = (h != holders.end()) && isHeld(h->second, vn);
+
+  if (held && dest.kind == tempOpd && h->second.type == dest.type && replace(i, dest, h->second)) {
+    dead[i] = true;
+    removed++;
+    return;
+  }
+
+  store(i, off, dest.type, vn);
+  if (!held) {
+    unordered_map<int, Operand>::iterator c = constants.find(vn);
+    holders[vn] = (c != constants.end()) ? c->second : named;
+  }
+}
+
+void ValueNumbering::numberBlock() {
+  words.clear();
+  holders.clear();
+  firstDefs.clear();
+
+  for (int i = blockStart; i < blockEnd; i++) {
+    const TacInstr& instr = code->getInstr(i);
+    Operand op1 = instr.getOperand1(), op2 = instr.getOperand2(), temp = instr.getTemp();
+
+    switch (instr.getOp()) {
+    case copyOpr:
+      if (op2.kind != noOpd) {
+        int vn = valueOf(op2);
+        if (op1.type != op2.type) {
+          vn = number(K_CONV, op1.type, vn, 0);
+        }
+        define(i, op1, vn);
+      }
+      break;
+    case addOpr:
+    case mulOpr:
+    case divOpr: {
+      int v1 = valueOf(op1), v2 = valueOf(op2);
+      // the same operation on swapped operands computes the same value (but for '/')
+      if (instr.getOp() != divOpr && op1.type == op2.type && v1 > v2) {
+        swap(v1, v2);
+      }
+      define(i, temp, number(instr.getOp() | (op1.type << 8) | (op2.type << 12), v1, v2, temp.type));
+    }
+      break;
+    case offsetOpr:
+      if (op2.kind == constOpd && width(temp.type) == 4) {
+        define(i, temp, word(location(op1) + op2.val.i));
+      } else {
+        store(i, location(temp), temp.type, counter++);
+      }
+      break;
+    case indexCopyOpr: {
+      int v = valueOf(op2), off = location(temp);
+      if (op1.kind != constOpd) {
+        // anything could have been overwritten
+        words.clear();
+        holders.clear();
+      } else if (word(off + op1.val.i) == v) {
+        // the word already holds the value
+        dead[i] = true;
+        redirect(i, Operand(temp.kind == instrOpd ? tempOpd : temp.kind, temp.type, off));
+        removed++;
+      } else {
+        words[off + op1.val.i] = v;
+        firstDefs.insert(make_pair(off + op1.val.i, i));
+      }
+    }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+int ValueNumbering::run() {
+  const int n = code->getNextInstr();
+
+  table.clear();
+  parts.clear();
+  constants.clear();
+  readRange.clear();
+  refs.clear();
+  counter = 0;
+  removed = 0;
+  opaque = false;
+  dead.assign(n, false);
+
+  // the range of instructions reading each word of memory, and the operands
+  // referring to the value of an instruction
+  for (int i = 0; i < n; i++) {
+    const TacInstr& instr = code->getInstr(i);
+    if (instr.getOperand1().kind == instrOpd) {
+      refs[instr.getOperand1().val.i].push_back(make_pair(i, 0));
+    }
+    if (instr.getOperand2().kind == instrOpd) {
+      refs[instr.getOperand2().val.i].push_back(make_pair(i, 1));
+    }
+
+    Access acc[3];
+    int k = reads(i, acc);
+
+    while (k-- > 0) {
+      if (acc[k].width < 0) {
+        opaque = true;
+        continue;
+      }
+      for (int o = acc[k].offset; o < acc[k].offset + acc[k].width; o += 4) {
+        Range& range = readRange[o];
+        if (range.first < 0) range.first = i;
+        range.last = i;
+      }
+    }
+  }
+
+  vector<bool> leader;
+  code->findLeaders(leader);
+
+  for (blockStart = 0; blockStart < n; blockStart = blockEnd) {
+    blockEnd = blockStart + 1;
+    while (blockEnd < n && !leader[blockEnd]) {
+      blockEnd++;
+    }
+    numberBlock();
+  }
+
+  code->remove(dead);
+
+  return removed;
+}
+
+int ValueNumbering::getRemoved() {
+  return removed;
+}
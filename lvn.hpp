@@ -0,0 +1,111 @@
+#ifndef LVN_HPP_
+#define LVN_HPP_
+
+/**
+ * @file lvn.hpp
+ * @brief This header file contains the local value numbering pass,
+ * which removes redundant computations from the 3-addr code.
+ */
+
+#include <vector>
+#include <unordered_map>
+#include "tinycomp.hpp"
+
+/** Local value numbering over the basic blocks of a TargetCode.
+ *
+ *  Within a block, every 4-byte word of Memory is labelled with the
+ *  number of the value it currently holds; instructions computing the
+ *  same operator on the same values (or loading the same word) get the
+ *  same value number. When an instruction computes a value that some
+ *  variable or temporary still holds, the instruction is removed and
+ *  the later uses of its result are rewritten to read that location.
+ *  A fraction is numbered as the pair of values of its two words.
+ */
+class ValueNumbering {
+private:
+  /** A value expression: an operator (or one of the kinds below) and up to three arguments */
+  struct Key {
+    int op;
+    int a, b, c;
+
+    bool operator==(const Key& k) const { return op == k.op && a == k.a && b == k.b && c == k.c; }
+  };
+
+  /** Functor for Key hashing */
+  struct KeyHash {
+    std::size_t operator()(const Key& k) const;
+  };
+
+  /** The memory accessed by an operand of an instruction */
+  struct Access {
+    /* the operand (0, 1 or 2 for the temp) */
+    int slot;
+    /* the location the operand refers to */
+    int loc;
+    /* the bytes actually accessed; a width of -1 means unknown */
+    int offset, width;
+  };
+
+  /** The first and last instruction reading a word of memory */
+  struct Range {
+    int first = -1, last = -1;
+  };
+
+  TargetCode* code;
+
+  /* value numbers of expressions; shared by all the blocks */
+  std::unordered_map<Key, int, KeyHash> table;
+  int counter;
+  /* the values of the two words of each fraction */
+  std::unordered_map<int, std::pair<int, int> > parts;
+  /* the constant each value number stands for, if any */
+  std::unordered_map<int, Operand> constants;
+
+  /* the instructions reading each word of memory */
+  std::unordered_map<int, Range> readRange;
+  /* the operands referring to the value of each instruction: (instruction, operand) */
+  std::unordered_map<int, std::vector<std::pair<int, int> > > refs;
+  /* set when some access can not be bounded; no use is rewritten then */
+  bool opaque;
+
+  /* value number of each word of Memory, within the current block */
+  std::unordered_map<int, int> words;
+  /* the first instruction writing each word, within the current block */
+  std::unordered_map<int, int> firstDefs;
+  /* a location (variable or temporary) or a constant holding each value number, within the current block */
+  std::unordered_map<int, Operand> holders;
+
+  /* first instruction of the current block and first one after it */
+  int blockStart, blockEnd;
+  std::vector<bool> dead;
+  int removed;
+
+  int number(int op, int a, int b, int c);
+  int word(int offset);
+  int location(const Operand& o);
+  int valueAt(int offset, typeName type);
+  int valueOf(const Operand& o);
+  void store(int i, int offset, typeName type, int vn);
+  bool isHeld(const Operand& loc, int vn);
+
+  int reads(int i, Access acc[3]);
+  bool writes(int i, Access& acc);
+
+  bool replace(int i, const Operand& dest, const Operand& loc);
+  void redirect(int i, const Operand& loc);
+  void define(int i, const Operand& dest, int vn);
+  void numberBlock();
+public:
+  /** Constructor; binds the pass to the code to be optimized */
+  ValueNumbering(TargetCode* code);
+
+  /** Runs the pass over the whole code, which is rewritten in place.
+   *  Returns the number of instructions removed.
+   */
+  int run();
+
+  /** Returns the number of instructions removed by the last run() */
+  int getRemoved();
+};
+
+#endif //LVN_HPP_
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "outbuf.hpp"
+
+OutBuf::OutBuf(ostream& out, size_t size) : out(out), cap(size < 64 ? 64 : size), len(0) {
+  buf = (char*)malloc(cap);
+}
+
+OutBuf::~OutBuf() {
+  flush();
+  free(buf);
+}
+
+void OutBuf::flush() {
+  if (len > 0) {
+    out.write(buf, len);
+    len = 0;
+  }
+  out.flush();
+}
+
+void OutBuf::alignRight(size_t start, int width) {
+  // if the buffer was flushed in the meantime, there's nothing to align
+  if (start > len) {
+    return;
+  }
+
+  size_t n = len - start;
+  if ((size_t)width <= n) {
+    return;
+  }
+
+  size_t pad = width - n;
+  if (cap - len < pad) {
+    return;
+  }
+
+  memmove(buf + start + pad, buf + start, n);
+  memset(buf + start, ' ', pad);
+  len += pad;
+}
+
+OutBuf& OutBuf::write(const char* s, size_t n) {
+  if (n > cap) {
+    flush();
+    out.write(s, n);
+    return *this;
+  }
+
+  reserve(n);
+  memcpy(buf + len, s, n);
+  len += n;
+  return *this;
+}
+
+OutBuf& OutBuf::putInt(long long v, int width) {
+  char digits[24];
+  int n = 0;
+  // work on the magnitude as unsigned, so that LLONG_MIN is fine too
+  unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+
+  do {
+    digits[n++] = '0' + (char)(u % 10);
+    u /= 10;
+  } while (u != 0);
+  if (v < 0) {
+    digits[n++] = '-';
+  }
+
+  int pad = width > n ? width - n : 0;
+  reserve(pad + n);
+
+  while (pad-- > 0) {
+    buf[len++] = ' ';
+  }
+  while (n > 0) {
+    buf[len++] = digits[--n];
+  }
+
+  return *this;
+}
+
+OutBuf& OutBuf::putFloat(double v, const char* fmt) {
+  // enough for any "%g"-like or "%2.2f"-like format of a float
+  reserve(64);
+
+  int n = snprintf(buf + len, cap - len, fmt, v);
+  assert(n >= 0);
+  if ((size_t)n >= cap - len) {
+    // "%f" of a huge value; give up on the last digits rather than allocate
+    n = cap - len - 1;
+  }
+  len += n;
+
+  return *this;
+}
+
+OutBuf& OutBuf::operator<<(const char* s) {
+  return write(s, strlen(s));
+}
@@ -0,0 +1,100 @@
+#ifndef OUTBUF_HPP_
+#define OUTBUF_HPP_
+
+/**
+ * @file outbuf.hpp
+ * @brief This header file contains the output buffer used to print
+ * out the IR, the symbol table and the memory map.
+ */
+
+#include <iostream>
+#include <cstddef>
+
+/** A large output buffer, written to an ostream only when it fills up or
+ *  when flush() is called (or it is destroyed).
+ *  Numbers are formatted straight into the buffer, so printing never
+ *  allocates memory.
+ */
+class OutBuf {
+private:
+  std::ostream& out;
+  char* buf;
+  std::size_t cap;
+  std::size_t len;
+
+  /* Makes sure there is room for n more characters */
+  void reserve(std::size_t n) {
+    if (cap - len < n) {
+      flush();
+    }
+  }
+
+  // Stop the compiler from generating methods of copy the object
+  OutBuf(OutBuf const& copy);            // Not to be implemented
+  OutBuf& operator=(OutBuf const& copy); // Not to be implemented
+public:
+  /** Default size of the buffer */
+  static const std::size_t SIZE = 1 << 16;
+
+  /** Constructor; the buffer will be written to out.
+   *  @param out The stream the buffer is flushed to
+   *  @param size The size of the buffer (at least 64 bytes)
+   */
+  OutBuf(std::ostream& out, std::size_t size = SIZE);
+
+  /** Destructor; flushes the buffer */
+  ~OutBuf();
+
+  /** Writes the content of the buffer to the stream, and empties it */
+  void flush();
+
+  /** Returns the number of characters currently in the buffer */
+  std::size_t size() const { return len; }
+
+  /** Right-aligns what has been printed since position start (as returned by size())
+   *  in a field of the given width, like setw() would do.
+   */
+  void alignRight(std::size_t start, int width);
+
+  /** Appends n characters */
+  OutBuf& write(const char* s, std::size_t n);
+
+  /** Appends a signed integer, right-aligned in a field of the given width */
+  OutBuf& putInt(long long v, int width = 0);
+
+  /** Appends a floating point number, formatted as printf() would do with fmt */
+  OutBuf& putFloat(double v, const char* fmt);
+
+  /** Appends a character */
+  OutBuf& operator<<(char c) {
+    reserve(1);
+    buf[len++] = c;
+    return *this;
+  }
+
+  /** Appends a NUL-terminated string */
+  OutBuf& operator<<(const char* s);
+
+  /** Appends an int */
+  OutBuf& operator<<(int v) { return putInt(v); }
+
+  /** Appends a long */
+  OutBuf& operator<<(long v) { return putInt(v); }
+
+  /** Appends a long long */
+  OutBuf& operator<<(long long v) { return putInt(v); }
+
+  /** Appends an unsigned int */
+  OutBuf& operator<<(unsigned int v) { return putInt(v); }
+
+  /** Appends an unsigned long (e.g. a size_t) */
+  OutBuf& operator<<(unsigned long v) { return putInt((long long)v); }
+
+  /** Appends a float, in the default format of ostream (that is, "%g") */
+  OutBuf& operator<<(float v) { return putFloat(v, "%g"); }
+
+  /** Appends a double, in the default format of ostream (that is, "%g") */
+  OutBuf& operator<<(double v) { return putFloat(v, "%g"); }
+};
+
+#endif //OUTBUF_HPP_
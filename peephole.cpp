@@ -0,0 +1,303 @@
+#include <iostream>
+
+#include <assert.h>
+
+using namespace std;
+
+#include "peephole.hpp"
+
+/* The patterns, tried in this order at each position of the window */
+const Peephole::Pattern Peephole::patterns[] = {
+  { "fraction store",      3, &Peephole::fractionStore },
+  { "result into target",  2, &Peephole::storeResult },
+  { "copy forwarding",     2, &Peephole::forwardCopy },
+  { "algebraic identity",  1, &Peephole::identity },
+  { nullptr, 0, nullptr }
+};
+
+/** The offset of the denominator in a fraction */
+static const int DENOM = sizeof(Fraction) / 2;
+
+static bool isJump(oprEnum op) {
+  return op == jmpOpr || op == jeOpr || op == condJmpOpr;
+}
+
+static bool same(const Operand& x, const Operand& y) {
+  return x.kind == y.kind && x.type == y.type && x.val.i == y.val.i;
+}
+
+static bool isInt(const Operand& o, int v) {
+  return o.kind == constOpd && o.type == intType && o.val.i == v;
+}
+
+static bool isLocation(const Operand& o) {
+  return o.kind == varOpd || o.kind == tempOpd;
+}
+
+Peephole::Peephole(TargetCode* code) : code(code), removed(0) {
+}
+
+/** Adds delta to the uses of the temporaries and instructions named by the operands of instruction i */
+void Peephole::account(int i, int delta) {
+  const TacInstr& instr = code->getInstr(i);
+  Operand o[3] = { instr.getOperand1(), instr.getOperand2(), instr.getTemp() };
+
+  for (int k = 0; k < 3; k++) {
+    if (o[k].kind == tempOpd) {
+      occ[o[k].val.i] += delta;
+    } else if (o[k].kind == instrOpd && !(k == 2 && isJump(instr.getOp()))) {
+      refs[o[k].val.i] += delta;
+    }
+  }
+}
+
+/** Replaces instruction i */
+void Peephole::replace(int i, const TacInstr& instr) {
+  account(i, -1);
+  code->getInstr(i) = instr;
+  account(i, +1);
+}
+
+/** Marks instruction i to be removed; a jump to it will land on the next instruction kept */
+void Peephole::kill(int i) {
+  const int n = code->getNextInstr();
+
+  account(i, -1);
+  assert(refs[i] == 0);
+  dead[i] = true;
+
+  if (leader[i]) {
+    int j = i + 1;
+    while (j < n && dead[j]) {
+      j++;
+    }
+    if (j < n) {
+      leader[j] = true;
+    }
+  }
+}
+
+/** Fills w with the indexes of the size instructions kept from i on.
+ *  Returns false if they are not all in the same basic block.
+ */
+bool Peephole::window(int i, int size, int* w) const {
+  const int n = code->getNextInstr();
+
+  w[0] = i;
+  for (int m = 1, j = i; m < size; m++) {
+    do {
+      j++;
+    } while (j < n && dead[j]);
+    if (j >= n || leader[j]) {
+      return false;
+    }
+    w[m] = j;
+  }
+  return true;
+}
+
+/** Returns how many operands name the temporary o, written by instruction i,
+ *  or refer to the value of i
+ */
+int Peephole::uses(const Operand& o, int i) const {
+  unordered_map<int, int>::const_iterator it = occ.find(o.val.i);
+
+  return (it != occ.end() ? it->second : 0) + refs[i];
+}
+
+/** t[0] = a; t[4] = b; y = t  =>  y[0] = a; y[4] = b
+ *  (a fraction built in a temporary only to be copied)
+ */
+bool Peephole::fractionStore(const int* w) {
+  const TacInstr &a = code->getInstr(w[0]), &b = code->getInstr(w[1]), &c = code->getInstr(w[2]);
+
+  if (a.getOp() != indexCopyOpr || b.getOp() != indexCopyOpr || c.getOp() != copyOpr) {
+    return false;
+  }
+
+  Operand t = a.getTemp(), y = c.getOperand1();
+
+  if (t.kind != tempOpd || t.type != fracType || !same(b.getTemp(), t) || !same(c.getOperand2(), t)) {
+    return false;
+  }
+  if (!isInt(a.getOperand1(), 0) || !isInt(b.getOperand1(), DENOM)) {
+    return false;
+  }
+  if (!isLocation(y) || y.type != fracType || same(y, t)) {
+    return false;
+  }
+  if (uses(t, w[0]) != 3 || refs[w[1]] != 0 || refs[w[2]] != 0) {
+    return false;
+  }
+
+  TacInstr na = a, nb = b;
+  na.setTemp(y);
+  nb.setTemp(y);
+  replace(w[0], na);
+  replace(w[1], nb);
+  kill(w[2]);
+  return true;
+}
+
+/** t = x op z; y = t  =>  y = x op z
+ *  (a result copied out of its temporary; also for t = x, and for offsets)
+ */
+bool Peephole::storeResult(const int* w) {
+  const TacInstr &a = code->getInstr(w[0]), &c = code->getInstr(w[1]);
+  const oprEnum op = a.getOp();
+
+  Operand t;
+  if (op == addOpr || op == mulOpr || op == divOpr || op == offsetOpr) {
+    t = a.getTemp();
+  } else if (op == copyOpr && a.getOperand2().kind != noOpd) {
+    t = a.getOperand1();
+  } else {
+    return false;
+  }
+
+  Operand y = c.getOperand1(), src = c.getOperand2();
+
+  if (c.getOp() != copyOpr || t.kind != tempOpd || !isLocation(y) || y.type != t.type || src.type != t.type) {
+    return false;
+  }
+  if (!same(src, t) && !(src.kind == instrOpd && src.val.i == w[0] && op != copyOpr)) {
+    return false;
+  }
+  if (uses(t, w[0]) != 2 || refs[w[1]] != 0) {
+    return false;
+  }
+
+  TacInstr na = a;
+  if (op == copyOpr) {
+    na.setOperand1(y);
+  } else {
+    na.setTemp(y);
+  }
+  replace(w[0], na);
+  kill(w[1]);
+  return true;
+}
+
+/** t = x; ... t ...  =>  ... x ...
+ *  (a copy into a temporary read once, by the next instruction)
+ */
+bool Peephole::forwardCopy(const int* w) {
+  const TacInstr &a = code->getInstr(w[0]), &b = code->getInstr(w[1]);
+  Operand t = a.getOperand1(), x = a.getOperand2();
+
+  if (a.getOp() != copyOpr || t.kind != tempOpd || x.kind == noOpd || x.type != t.type) {
+    return false;
+  }
+  if (uses(t, w[0]) != 2) {
+    return false;
+  }
+
+  // the operand of b reading t (the first operand of a copy is written instead)
+  Operand o[2] = { b.getOperand1(), b.getOperand2() };
+  int k = -1;
+  for (int m = (b.getOp() == copyOpr) ? 1 : 0; m < 2; m++) {
+    if (same(o[m], t)) {
+      k = m;
+    }
+  }
+  if (k < 0) {
+    return false;
+  }
+  // the base of an offset must be in memory
+  if (x.kind == constOpd && b.getOp() == offsetOpr && k == 0) {
+    return false;
+  }
+
+  TacInstr nb = b;
+  if (k == 0) {
+    nb.setOperand1(x);
+  } else {
+    nb.setOperand2(x);
+  }
+  replace(w[1], nb);
+  kill(w[0]);
+  return true;
+}
+
+/** t = x + 0, t = x * 1, t = x / 1 (and the symmetric ones)  =>  t = x
+ *  y = y  =>  (nothing)
+ *  (ints only, since x + 0.0 is not x for x = -0.0)
+ */
+bool Peephole::identity(const int* w) {
+  const TacInstr& a = code->getInstr(w[0]);
+  const oprEnum op = a.getOp();
+  Operand x = a.getOperand1(), z = a.getOperand2(), t = a.getTemp();
+
+  if (op == copyOpr && z.kind != noOpd && same(x, z) && isLocation(x)) {
+    if (refs[w[0]] != 0) {
+      return false;
+    }
+    kill(w[0]);
+    return true;
+  }
+
+  if ((op != addOpr && op != mulOpr && op != divOpr) || x.type != intType || z.type != intType
+      || !isLocation(t) || refs[w[0]] != 0) {
+    return false;
+  }
+
+  const int unit = (op == addOpr) ? 0 : 1;
+  Operand src;
+  if (isInt(z, unit)) {
+    src = x;
+  } else if (isInt(x, unit) && op != divOpr) {
+    src = z;
+  } else {
+    return false;
+  }
+
+  replace(w[0], TacInstr(copyOpr, t, src, Operand()));
+  return true;
+}
+
+int Peephole::run() {
+  const int n = code->getNextInstr();
+
+  int count = 0;
+  while (patterns[count].name != nullptr) {
+    count++;
+  }
+  hits.assign(count, 0);
+  removed = 0;
+
+  dead.assign(n, false);
+  code->findLeaders(leader);
+  occ.clear();
+  refs.assign(n, 0);
+  for (int i = 0; i < n; i++) {
+    account(i, +1);
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < n; i++) {
+      // after a rewrite, the patterns are tried again at the same position
+      for (int p = 0; p < count && !dead[i]; ) {
+        int w[3];
+        if (window(i, patterns[p].size, w) && (this->*patterns[p].rewrite)(w)) {
+          hits[p]++;
+          changed = true;
+          p = 0;
+        } else {
+          p++;
+        }
+      }
+    }
+  }
+
+  removed = code->remove(dead);
+  return removed;
+}
+
+void Peephole::printOut(OutBuf& out) const {
+  for (size_t p = 0; p < hits.size(); p++) {
+    out << patterns[p].name << ": " << hits[p] << '\n';
+  }
+  out << "removed " << removed << " instructions\n";
+}
@@ -0,0 +1,79 @@
+#ifndef PEEPHOLE_HPP_
+#define PEEPHOLE_HPP_
+
+/**
+ * @file peephole.hpp
+ * @brief This header file contains the peephole optimizer, which rewrites
+ * short wasteful sequences of 3-addr code.
+ */
+
+#include <vector>
+#include <unordered_map>
+#include "tinycomp.hpp"
+
+/** A peephole optimizer over the instructions of a TargetCode.
+ *
+ *  A window slides over the code, never crossing the start of a basic
+ *  block; at each position the patterns of a table are tried in order, and
+ *  the first one matching rewrites the window in place (the instructions it
+ *  no longer needs are removed at the end). Patterns only fire when the
+ *  temporaries they eliminate are not used anywhere else, which is checked
+ *  against a count of the uses of each temporary and instruction, kept up
+ *  to date as the code is rewritten. The whole code is scanned again until
+ *  no pattern matches.
+ *
+ *  A new pattern is a method matching a window of the given size, added to
+ *  the table in peephole.cpp.
+ */
+class Peephole {
+private:
+  /** A rewrite pattern: a name, the size of its window and the method that
+   *  rewrites a window (given as the indexes of its instructions), returning
+   *  false if it does not match.
+   */
+  struct Pattern {
+    const char* name;
+    int size;
+    bool (Peephole::*rewrite)(const int* w);
+  };
+
+  static const Pattern patterns[];
+
+  TargetCode* code;
+
+  std::vector<bool> dead;
+  std::vector<bool> leader;
+  /* the operands naming each temporary (by offset), and those referring to each instruction */
+  std::unordered_map<int, int> occ;
+  std::vector<int> refs;
+
+  std::vector<int> hits;
+  int removed;
+
+  void account(int i, int delta);
+  void replace(int i, const TacInstr& instr);
+  void kill(int i);
+  bool window(int i, int size, int* w) const;
+  int uses(const Operand& o, int i) const;
+
+  bool fractionStore(const int* w);
+  bool storeResult(const int* w);
+  bool forwardCopy(const int* w);
+  bool identity(const int* w);
+public:
+  /** Constructor; binds the optimizer to the code it rewrites */
+  Peephole(TargetCode* code);
+
+  /** Rewrites the code until no pattern matches.
+   *  Returns the number of instructions removed.
+   */
+  int run();
+
+  /** Returns the number of instructions removed by the last run() */
+  int getRemoved() const { return removed; }
+
+  /** Prints out how many times each pattern fired */
+  void printOut(OutBuf& out) const;
+};
+
+#endif //PEEPHOLE_HPP_
@@ -0,0 +1,298 @@
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "server.hpp"
+
+/** The longest frame accepted (a program, or what it printed out) */
+static const uint32_t MAXFRAME = 1u << 30;
+
+/** Writes all the n bytes at buf to fd. Returns false if the peer went away */
+static bool writeAll(int fd, const char* buf, size_t n) {
+  while (n > 0) {
+    // MSG_NOSIGNAL: a client going away must not kill the server with a SIGPIPE
+    ssize_t k = send(fd, buf, n, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR) {
+      continue;
+    }
+    if (k <= 0) {
+      return false;
+    }
+    buf += k;
+    n -= k;
+  }
+  return true;
+}
+
+/** Reads exactly n bytes from fd into buf. Returns false at the end of the stream */
+static bool readAll(int fd, char* buf, size_t n) {
+  while (n > 0) {
+    ssize_t k = read(fd, buf, n);
+    if (k < 0 && errno == EINTR) {
+      continue;
+    }
+    if (k <= 0) {
+      return false;
+    }
+    buf += k;
+    n -= k;
+  }
+  return true;
+}
+
+static bool writeWord(int fd, uint32_t w) {
+  w = htonl(w);
+  return writeAll(fd, (const char*)&w, sizeof(w));
+}
+
+static bool readWord(int fd, uint32_t& w) {
+  if (!readAll(fd, (char*)&w, sizeof(w))) {
+    return false;
+  }
+  w = ntohl(w);
+  return true;
+}
+
+static bool writeFrame(int fd, const string& s) {
+  return writeWord(fd, s.size()) && writeAll(fd, s.data(), s.size());
+}
+
+/** Reads a frame into s, followed by pad NUL bytes (not counted in the length returned) */
+static bool readFrame(int fd, string& s, size_t& length, size_t pad) {
+  uint32_t n;
+  if (!readWord(fd, n) || n > MAXFRAME) {
+    return false;
+  }
+  s.assign(n + pad, '\0');
+  length = n;
+  return readAll(fd, &s[0], n);
+}
+
+/** Fills addr with the address of the socket at path. Returns false if the path is too long */
+static bool address(const string& path, sockaddr_un& addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+/*
+ * Server
+ */
+Server::Server(const string& path, ostream& err, Cache* cache) : path(path), err(err), cache(cache) {
+}
+
+int Server::run() {
+  sockaddr_un addr;
+  if (!address(path, addr)) {
+    err << "Socket path too long: " << path << endl;
+    return 1;
+  }
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    err << "Can not create a socket: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  // replace the socket left by a previous server, but nothing else
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    unlink(path.c_str());
+  }
+
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+    err << "Can not listen on " << path << ": " << strerror(errno) << endl;
+    close(fd);
+    return 1;
+  }
+
+  for (;;) {
+    int conn = accept(fd, nullptr, nullptr);
+    if (conn < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      err << "Can not accept a connection: " << strerror(errno) << endl;
+      continue;
+    }
+    thread(&Server::serve, this, conn).detach();
+  }
+}
+
+/** Serves the requests sent over one connection, until the client closes it */
+void Server::serve(int fd) {
+  ostringstream errs;
+  CompilerContext ctx(errs);
+  string options, source;
+  size_t length;
+
+  // flex needs two NUL bytes after the program it scans in place
+  while (readFrame(fd, options, length, 0) && readFrame(fd, source, length, 2)) {
+    string out, perr;
+    int status = 0;
+
+    Options opt;
+    istringstream flags(options);
+    string flag;
+    while (flags >> flag) {
+      if (!opt.set(flag)) {
+        perr += "Unknown option " + flag + "\n";
+        status = 2;
+      }
+    }
+
+    if (status == 0) {
+      SourceBuffer src;
+      src.wrap(&source[0], length);
+
+      auto build = [&ctx, &errs, &src](const Options& opt, Checkpoints* checkpoints, string& printed, string& errors) {
+        ostringstream outs;
+        int res;
+        try {
+          OutBuf buf(outs);
+          ctx.checkpoints = checkpoints;
+          res = ctx.compile(nullptr, src, opt, buf);
+        } catch (const exception& e) {
+          // a failed compilation must not take the connection down
+          errs << e.what() << endl;
+          res = 1;
+        }
+        ctx.checkpoints = nullptr;
+        ctx.reset();
+
+        printed = outs.str();
+        errors = errs.str();
+        errs.str("");
+        errs.clear();
+        return res;
+      };
+
+      status = cache != nullptr ? cache->compile(src, opt, build, out, perr) : build(opt, nullptr, out, perr);
+    }
+
+    if (!writeWord(fd, status) || !writeFrame(fd, out) || !writeFrame(fd, perr)) {
+      break;
+    }
+  }
+  close(fd);
+
+  if (cache != nullptr) {
+    cache->printOut(err);
+  }
+}
+
+/*
+ * Client
+ */
+Client::Client(const string& path) : path(path) {
+}
+
+/** Returns the p-th percentile (nearest rank) of the sorted latencies */
+static double percentile(const vector<double>& sorted, double p) {
+  size_t rank = (size_t)ceil(p / 100 * sorted.size());
+  return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+int Client::replay(const vector<string>& files, const Options& opt, int rounds,
+                   ostream& out, ostream& err) {
+  // the programs are read once, so that only the server is timed
+  vector<string> sources;
+  for (size_t i = 0; i < files.size(); i++) {
+    ifstream in(files[i].c_str(), ios::binary);
+    if (!in) {
+      err << "Can not open " << files[i] << endl;
+      return 1;
+    }
+    ostringstream s;
+    s << in.rdbuf();
+    sources.push_back(s.str());
+  }
+
+  sockaddr_un addr;
+  if (!address(path, addr)) {
+    err << "Socket path too long: " << path << endl;
+    return 1;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    err << "Can not connect to " << path << ": " << strerror(errno) << endl;
+    if (fd >= 0) {
+      close(fd);
+    }
+    return 1;
+  }
+
+  const string options = opt.flags();
+  const bool headers = files.size() > 1;
+  vector<double> latencies;
+  latencies.reserve(files.size() * rounds);
+  int res = 0;
+
+  auto start = chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < files.size(); i++) {
+      auto sent = chrono::steady_clock::now();
+
+      uint32_t status;
+      string pout, perr;
+      size_t length;
+      if (!writeFrame(fd, options) || !writeFrame(fd, sources[i])
+          || !readWord(fd, status) || !readFrame(fd, pout, length, 0) || !readFrame(fd, perr, length, 0)) {
+        err << "Connection to " << path << " lost" << endl;
+        close(fd);
+        return 1;
+      }
+
+      latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - sent).count());
+
+      if (r == 0) {
+        if (headers) {
+          out << "==> " << files[i] << " <==\n";
+        }
+        out << pout;
+        if (!perr.empty()) {
+          out.flush();
+          if (headers) {
+            err << "==> " << files[i] << " <==\n";
+          }
+          err << perr;
+          err.flush();
+        }
+        if (status != 0) {
+          res = 1;
+        }
+      }
+    }
+  }
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  close(fd);
+  out.flush();
+
+  if (!latencies.empty()) {
+    sort(latencies.begin(), latencies.end());
+    err << "Sent " << latencies.size() << " requests (" << files.size() << " programs, "
+        << rounds << " rounds) in " << secs << " s" << endl;
+    err << "Latency: p50 " << percentile(latencies, 50) << " us, p90 " << percentile(latencies, 90)
+        << " us, p99 " << percentile(latencies, 99) << " us, max " << latencies.back() << " us" << endl;
+  }
+  return res;
+}
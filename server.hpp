@@ -0,0 +1,84 @@
+#ifndef SERVER_HPP_
+#define SERVER_HPP_
+
+/**
+ * @file server.hpp
+ * @brief This header file contains the compile server, which keeps the
+ * compiler running and compiles the programs sent over a Unix socket,
+ * and the client that replays programs against it.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "context.hpp"
+#include "cache.hpp"
+
+/** A compiler that stays up, and compiles the programs sent to it over a
+ *  local (Unix domain) socket, saving the start-up of a process for each.
+ *
+ *  Every message is made of frames: a 4-byte length, in network byte
+ *  order, followed by that many bytes. A request is two frames:
+ *    - the options, as command-line flags separated by spaces (e.g. "--run");
+ *    - the source of the program.
+ *  The response is a 4-byte status (0 on success, as returned by
+ *  CompilerContext::compile(); 2 for a bad option), followed by two frames:
+ *  what the program printed out, and the errors and statistics.
+ *
+ *  Each connection is served by its own thread, with its own CompilerContext,
+ *  which is reset after every request: the memory, symbol table, code and
+ *  arena of a program are emptied but not released, so a client sending
+ *  many programs over the same connection allocates (almost) nothing.
+ *  With a Cache, a program compiled before is not even parsed.
+ */
+class Server {
+private:
+  std::string path;
+  std::ostream& err;
+  Cache* cache;
+
+  void serve(int fd);
+
+  // Stop the compiler from generating methods of copy the object
+  Server(Server const& copy);            // Not to be implemented
+  Server& operator=(Server const& copy); // Not to be implemented
+public:
+  /** Constructor.
+   *  @param path The path of the socket to listen on (an old socket there is replaced)
+   *  @param err The stream errors of the server itself are printed out to
+   *  @param cache Where to look for programs compiled before (NULL for none)
+   */
+  Server(const std::string& path, std::ostream& err, Cache* cache);
+
+  /** Accepts connections, and serves them, forever.
+   *  Returns 1 only if the socket could not be set up.
+   */
+  int run();
+};
+
+/** A client of the Server, which sends a list of programs to it over and
+ *  over, and reports how long each request took.
+ */
+class Client {
+private:
+  std::string path;
+
+  // Stop the compiler from generating methods of copy the object
+  Client(Client const& copy);            // Not to be implemented
+  Client& operator=(Client const& copy); // Not to be implemented
+public:
+  /** Constructor, for the server listening on the socket at path */
+  Client(const std::string& path);
+
+  /** Sends the programs in files, in order, rounds times, over a single
+   *  connection. What the server returns for the first round is printed out
+   *  on out and err, after a header naming each program when there are
+   *  several (as Batch does);
+   *  the percentiles of the latency of the requests then go to err.
+   *  Returns 0 if every program was compiled (and run) successfully.
+   */
+  int replay(const std::vector<std::string>& files, const Options& opt, int rounds,
+             std::ostream& out, std::ostream& err);
+};
+
+#endif //SERVER_HPP_
@@ -0,0 +1,57 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "source.hpp"
+
+SourceBuffer::SourceBuffer() : base(nullptr), size(0), region(nullptr), mapped(0) {
+}
+
+SourceBuffer::~SourceBuffer() {
+  if (mapped != 0) {
+    munmap(region, mapped);
+  }
+}
+
+bool SourceBuffer::map(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+  const off_t offset = lseek(fd, 0, SEEK_CUR);
+  if (offset < 0 || offset >= st.st_size) {
+    return false;
+  }
+
+  // a file is mapped from a page boundary: the program starts skip bytes into the mapping
+  const size_t page = sysconf(_SC_PAGESIZE);
+  const size_t skip = offset % page;
+  const size_t n = skip + (st.st_size - offset);
+  const size_t len = (n + 2 + page - 1) / page * page;
+
+  // the zero-filled pages after the file supply the NUL bytes flex needs
+  void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+  if (mmap(p, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset - skip) == MAP_FAILED) {
+    munmap(p, len);
+    return false;
+  }
+  madvise(p, n, MADV_SEQUENTIAL);
+
+  region = (char*)p;
+  base = region + skip;
+  size = n - skip;
+  mapped = len;
+  return true;
+}
+
+void SourceBuffer::wrap(char* data, size_t length) {
+  base = data;
+  size = length;
+  region = nullptr;
+  mapped = 0;
+}
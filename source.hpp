@@ -0,0 +1,80 @@
+#ifndef SOURCE_HPP_
+#define SOURCE_HPP_
+
+/**
+ * @file source.hpp
+ * @brief This header file contains the source buffer, which maps a
+ * program into memory so that the lexer can scan it in place.
+ */
+
+#include <cstddef>
+#include <cstdio>
+
+/** A program mapped into memory, followed by the two NUL bytes that flex
+ *  expects at the end of a buffer it scans in place (see parseSource()).
+ *
+ *  The file is mapped over a slightly larger anonymous mapping, so the two
+ *  NUL bytes are there even when the file ends at a page boundary, and the
+ *  program is never copied. The mapping is private and writable, since the
+ *  lexer writes a NUL after each token it hands out; only the pages written
+ *  to are copied, by the kernel.
+ */
+class SourceBuffer {
+private:
+  char* base;
+  std::size_t size;
+  /* the whole mapping, which starts at the page holding base */
+  char* region;
+  std::size_t mapped;
+
+  // Stop the compiler from generating methods of copy the object
+  SourceBuffer(SourceBuffer const& copy);            // Not to be implemented
+  SourceBuffer& operator=(SourceBuffer const& copy); // Not to be implemented
+public:
+  /** Constructor for an empty buffer */
+  SourceBuffer();
+
+  /** Destructor; unmaps the program (if it was mapped by map()) */
+  ~SourceBuffer();
+
+  /** Maps the regular file open as fd into memory, from the current offset
+   *  of fd on (the part of a stdin already read by someone else is skipped).
+   *  Returns false if fd is not a regular file (e.g. a pipe), has nothing
+   *  left to read, or can not be mapped; the buffer stays empty then.
+   */
+  bool map(int fd);
+
+  /** Uses the program of the given length already in memory at data,
+   *  which must be followed by two NUL bytes. The buffer does not own
+   *  the program, and will not release it.
+   */
+  void wrap(char* data, std::size_t length);
+
+  /** Returns the first byte of the program */
+  char* getBase() const { return base; }
+
+  /** Returns the size of the program in bytes (not counting the NUL bytes) */
+  std::size_t getSize() const { return size; }
+};
+
+class CompilerContext;
+
+/** Parses the program read from in (or already mapped into src, when that
+ *  is not empty), generating its code into ctx. Returns 0 on success.
+ *  Defined in tinycomp.l, since it needs the internals of flex.
+ */
+int parseSource(CompilerContext* ctx, FILE* in, SourceBuffer& src);
+
+/** Parses the program as parseSource() does, but splits all of it into
+ *  tokens first, so that the time spent by the lexer and by the parser can
+ *  be told apart (the end of lexing is a lap of ctx->stats). Lexical errors
+ *  are all reported before the syntax errors. Defined in tinycomp.l.
+ */
+int parseTokens(CompilerContext* ctx, FILE* in, SourceBuffer& src);
+
+/** Splits the program read from in (or mapped into src) into tokens, and
+ *  returns how many there are. Defined in tinycomp.l.
+ */
+long lexSource(CompilerContext* ctx, FILE* in, SourceBuffer& src);
+
+#endif //SOURCE_HPP_
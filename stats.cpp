@@ -0,0 +1,170 @@
+#include <iostream>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+#include "stats.hpp"
+
+/*
+ * HeapCount
+ */
+static thread_local HeapCount heapCount = {0, 0};
+
+HeapCount& HeapCount::current() {
+  return heapCount;
+}
+
+/** Counts an allocation of size bytes, and makes it (aligned to align, unless it
+ *  is 0); as the operator new it replaces, calls the new handler until the
+ *  memory can be had, and throws bad_alloc if there is none.
+ */
+static void* allocate(size_t size, size_t align) {
+  heapCount.allocations++;
+  heapCount.bytes += size;
+
+  if (size == 0) {
+    size = 1;
+  }
+  for (;;) {
+    // aligned_alloc() wants a multiple of the alignment
+    void* p = (align == 0) ? malloc(size) : aligned_alloc(align, (size + align - 1) / align * align);
+    if (p != nullptr) {
+      return p;
+    }
+    new_handler handler = get_new_handler();
+    if (handler == nullptr) {
+      throw bad_alloc();
+    }
+    handler();
+  }
+}
+
+/* The replacements of the global operator new and delete, counting the
+   allocations of each thread; this only costs a couple of increments. The
+   other forms (arrays, nothrow) call these by default. */
+void* operator new(size_t size) {
+  return allocate(size, 0);
+}
+
+void* operator new(size_t size, align_val_t align) {
+  return allocate(size, (size_t)align);
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, align_val_t) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept {
+  free(p);
+}
+
+/*
+ * Stats
+ */
+
+/** The names of the operators, as printed out in the statistics (indexed by oprEnum) */
+static const char* const oprNames[] = {
+  "unknown", "halt", "copy", "add", "mul", "div", "indexCopy", "offset", "jmp", "je", "condJmp", "fake"
+};
+
+static const int OPERATORS = sizeof(oprNames) / sizeof(oprNames[0]);
+
+Stats::Stats() : enabled(false), heap{0, 0}, parsedMemory(0) {
+}
+
+void Stats::start(bool enabled) {
+  this->enabled = enabled;
+  phases.clear();
+  generated.assign(OPERATORS, 0);
+  parsedMemory = 0;
+
+  if (enabled) {
+    heap = HeapCount::current();
+    last = Clock::now();
+  }
+}
+
+void Stats::record(const char* phase) {
+  const Clock::time_point now = Clock::now();
+  const HeapCount& h = HeapCount::current();
+
+  Phase p = { phase, chrono::duration<double>(now - last).count(),
+              h.allocations - heap.allocations, h.bytes - heap.bytes };
+  phases.push_back(p);
+
+  // the phases are timed without the bookkeeping of the statistics
+  heap = HeapCount::current();
+  last = Clock::now();
+}
+
+/** Counts the instructions in code by operator, into counts */
+static void countInstrs(TargetCode& code, vector<int>& counts) {
+  counts.assign(OPERATORS, 0);
+  for (int i = 0; i < code.getNextInstr(); i++) {
+    const int op = code.getInstr(i).getOp();
+    if (op >= 0 && op < OPERATORS) {
+      counts[op]++;
+    }
+  }
+}
+
+void Stats::count(TargetCode& code, Memory& mem) {
+  if (enabled) {
+    countInstrs(code, generated);
+    parsedMemory = mem.getSize();
+    // not part of any phase
+    last = Clock::now();
+  }
+}
+
+/** Prints out counts as a JSON object, by name of the operator */
+static void printInstrs(ostream& out, const vector<int>& counts) {
+  int total = 0;
+  out << '{';
+  for (int op = 0; op < OPERATORS; op++) {
+    out << '"' << oprNames[op] << "\":" << counts[op] << ',';
+    total += counts[op];
+  }
+  out << "\"total\":" << total << '}';
+}
+
+void Stats::printOut(ostream& out, TargetCode& code, Memory& mem, const Arena& arena) {
+  double seconds = 0;
+  size_t allocations = 0, bytes = 0;
+
+  out << "{\"phases\":{";
+  for (size_t k = 0; k < phases.size(); k++) {
+    const Phase& p = phases[k];
+    out << '"' << p.name << "\":{\"seconds\":" << p.seconds << ",\"allocations\":" << p.allocations
+        << ",\"bytes\":" << p.bytes << "},";
+    seconds += p.seconds;
+    allocations += p.allocations;
+    bytes += p.bytes;
+  }
+  out << "\"total\":{\"seconds\":" << seconds << ",\"allocations\":" << allocations
+      << ",\"bytes\":" << bytes << "}}";
+
+  vector<int> final;
+  countInstrs(code, final);
+  out << ",\"instructions\":{\"generated\":";
+  printInstrs(out, generated);
+  out << ",\"final\":";
+  printInstrs(out, final);
+  out << '}';
+
+  out << ",\"temporaries\":" << mem.getTemps();
+  out << ",\"memory\":{\"parsed\":" << parsedMemory << ",\"final\":" << mem.getSize() << '}';
+  out << ",\"backpatch\":{\"calls\":" << code.getBackpatches() << ",\"patched\":" << code.getPatched() << '}';
+  out << ",\"arena\":{\"objects\":" << arena.getObjects() << ",\"bytes\":" << arena.getBytes()
+      << ",\"reserved\":" << arena.getReserved() << '}';
+  out << '}' << endl;
+}
@@ -0,0 +1,92 @@
+#ifndef STATS_HPP_
+#define STATS_HPP_
+
+/**
+ * @file stats.hpp
+ * @brief This header file contains the statistics of a compilation,
+ * printed out as JSON by --stats.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include "tinycomp.hpp"
+
+/** The heap allocations made by a thread: every call of operator new,
+ *  aligned or not (both are replaced in stats.cpp), is counted, whether --stats is given
+ *  or not. The memory of the program, the arena blocks and the output
+ *  buffers come from malloc(), and are not counted here.
+ */
+struct HeapCount {
+  std::size_t allocations;  /*!< the number of calls of operator new */
+  std::size_t bytes;        /*!< the bytes requested by them */
+
+  /** Returns the counts of the calling thread */
+  static HeapCount& current();
+};
+
+/** The statistics of the compilation of one program: the wall time and the
+ *  heap allocations of each phase, the instructions generated (by operator)
+ *  and left after the passes, the temporaries, the memory and the backpatching.
+ *
+ *  When it is not enabled, lap() and count() return at once, and nothing
+ *  else is done: the counters it reports (Memory::getTemps(),
+ *  TargetCode::getBackpatches(), HeapCount) are kept anyway.
+ */
+class Stats {
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  /* A phase of the compilation */
+  struct Phase {
+    const char* name;
+    double seconds;
+    std::size_t allocations;
+    std::size_t bytes;
+  };
+
+  bool enabled;
+  Clock::time_point last;
+  HeapCount heap;
+  std::vector<Phase> phases;
+
+  /* the instructions by operator, and the memory in use, once parsed */
+  std::vector<int> generated;
+  int parsedMemory;
+
+  void record(const char* phase);
+
+  // Stop the compiler from generating methods of copy the object
+  Stats(Stats const& copy);            // Not to be implemented
+  Stats& operator=(Stats const& copy); // Not to be implemented
+public:
+  /** Constructor; the statistics are not enabled */
+  Stats();
+
+  /** Begins a compilation; the statistics are only gathered if enabled is set */
+  void start(bool enabled);
+
+  /** Returns true if the statistics are being gathered */
+  bool isEnabled() const { return enabled; }
+
+  /** Ends a phase of the compilation, which began at the end of the
+   *  previous one (or at start()).
+   *  @param phase The name of the phase, which must be a literal
+   */
+  void lap(const char* phase) {
+    if (enabled) {
+      record(phase);
+    }
+  }
+
+  /** Counts the instructions generated by the parser, by operator, and the memory in use */
+  void count(TargetCode& code, Memory& mem);
+
+  /** Prints out the statistics as a single line of JSON.
+   *  The code, memory and arena are those of the program, as left by the compilation.
+   */
+  void printOut(std::ostream& out, TargetCode& code, Memory& mem, const Arena& arena);
+};
+
+#endif //STATS_HPP_
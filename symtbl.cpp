@@ -0,0 +1,242 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+#include "symtbl.hpp"
+
+/** The number of slots of the hash table of an empty pool (a power of 2) */
+static const size_t MINSLOTS = 64;
+
+/*
+ * SymTbl
+ */
+void SymTbl::printValue(OutBuf& out, typeName type, const void* val) {
+  switch (type) {
+  case intType:
+    out << *(const int*)val;
+    break;
+  case floatType:
+    out << *(const float*)val;
+    break;
+  case fracType: {
+    const Fraction* f = (const Fraction*)val;
+    out << f->num << "|" << f->denom;
+  }
+    break;
+  default:
+    /* should not occur */
+    out << "?";
+    break;
+  }
+}
+
+/*
+ * StringPool
+ */
+StringPool::StringPool() : chars("names", 4096), slots(MINSLOTS, 0) {
+}
+
+/** FNV-1a hash of the bytes of a string */
+uint32_t StringPool::hash(const char* s, size_t length) {
+  uint32_t h = 2166136261u;
+
+  for (size_t i = 0; i < length; i++) {
+    h = (h ^ (unsigned char)s[i]) * 16777619u;
+  }
+  return h;
+}
+
+/** Returns the slot holding the id of the string, or the free slot where it would go */
+size_t StringPool::probe(const char* s, size_t length, uint32_t h) const {
+  const size_t mask = slots.size() - 1;
+
+  for (size_t i = h & mask; ; i = (i + 1) & mask) {
+    uint32_t slot = slots[i];
+    if (slot == 0) {
+      return i;
+    }
+    // the lengths are compared first, so that memcmp never reads past the end of t
+    if (hashes[slot - 1] == h && lengths[slot - 1] == length && memcmp(strings[slot - 1], s, length) == 0) {
+      return i;
+    }
+  }
+}
+
+/** Doubles the hash table, placing the ids again by their stored hashes */
+void StringPool::grow() {
+  vector<uint32_t> old(slots.size() * 2, 0);
+  old.swap(slots);
+
+  const size_t mask = slots.size() - 1;
+  for (size_t id = 0; id < strings.size(); id++) {
+    size_t i = hashes[id] & mask;
+    while (slots[i] != 0) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = id + 1;
+  }
+}
+
+int StringPool::intern(const char* s, size_t length) {
+  const uint32_t h = hash(s, length);
+  size_t i = probe(s, length, h);
+
+  if (slots[i] != 0) {
+    return slots[i] - 1;
+  }
+
+  char* copy = (char*)chars.allocate(length + 1);
+  memcpy(copy, s, length);
+  copy[length] = '\0';
+
+  const int id = strings.size();
+  strings.push_back(copy);
+  hashes.push_back(h);
+  lengths.push_back(length);
+  slots[i] = id + 1;
+
+  // keep the table at most half full
+  if (strings.size() * 2 > slots.size()) {
+    grow();
+  }
+  return id;
+}
+
+void StringPool::reset() {
+  chars.reset();
+  strings.clear();
+  hashes.clear();
+  lengths.clear();
+  // the table keeps its size, as the next program is likely to need as many slots
+  fill(slots.begin(), slots.end(), 0);
+}
+
+int StringPool::find(const char* s) const {
+  const size_t length = strlen(s);
+  size_t i = probe(s, length, hash(s, length));
+
+  return (int)slots[i] - 1;
+}
+
+void StringPool::printOut(OutBuf& out) const {
+  chars.printOut(out);
+  out << strings.size() << " names, hashed in " << slots.size() << " slots\n";
+}
+
+/*
+ * HashSymTbl
+ */
+HashSymTbl::HashSymTbl(Memory& mem) : SymTbl(mem) {
+}
+
+void HashSymTbl::reset() {
+  names.reset();
+  sym.clear();
+}
+
+int HashSymTbl::intern(const char* lexeme, size_t length) {
+  int id = names.intern(lexeme, length);
+
+  if (id == (int)sym.size()) {
+    sym.push_back(NULL);
+  }
+  return id;
+}
+
+VarAddress* HashSymTbl::get(const char* lexeme) {
+  int id = names.find(lexeme);
+
+  return (id < 0) ? NULL : sym[id];
+}
+
+void HashSymTbl::put(const char* lexeme, typeName type) {
+  put(intern(lexeme, strlen(lexeme)), type);
+}
+
+void HashSymTbl::put(int id, typeName type) {
+  int offset = 0;
+
+  // we store variables in memory, initializing them with a default value depending on their type
+  switch(type) {
+  case intType: {
+    int intVal = 0;
+    offset = mem.store(&intVal, sizeof(int));
+  }
+    break;
+  case floatType: {
+    float floatVal = 0;
+    offset = mem.store(&floatVal, sizeof(float));
+  }
+    break;
+  case fracType: {
+    Fraction fracVal(0,0);
+    offset = mem.store(&fracVal, sizeof(Fraction));
+  }
+    break;
+  default:
+    break;
+  }
+
+  sym[id] = new VarAddress(names.getString(id), type, offset);
+}
+
+void HashSymTbl::getVariables(vector<VarAddress*>& vars) {
+  vector<int> ids;
+  for (size_t id = 0; id < sym.size(); id++) {
+    if (sym[id] != NULL) {
+      ids.push_back(id);
+    }
+  }
+
+  sort(ids.begin(), ids.end(), [this](int x, int y) {
+    return strcmp(names.getString(x), names.getString(y)) < 0;
+  });
+
+  vars.clear();
+  for (size_t k = 0; k < ids.size(); k++) {
+    vars.push_back(sym[ids[k]]);
+  }
+}
+
+void HashSymTbl::printValues(OutBuf& out) {
+  vector<VarAddress*> vars;
+  getVariables(vars);
+
+  for (size_t k = 0; k < vars.size(); k++) {
+    void* val = mem.retrieve(vars[k]->getOffset());
+
+    out << vars[k] << " = ";
+    printValue(out, vars[k]->getType(), val);
+    out << '\n';
+  }
+}
+
+void HashSymTbl::printOut(OutBuf& out) {
+  vector<VarAddress*> vars;
+  getVariables(vars);
+
+  for (size_t k = 0; k < vars.size(); k++) {
+    VarAddress* v = vars[k];
+    switch (v->getType()) {
+    case intType:
+      out << k << ") : " << v << " (int)   - offset = " << v->getOffset() << '\n';
+      break;
+    case floatType:
+      out << k << ") : " << v << " (float) - offset = " << v->getOffset() << '\n';
+      break;
+    case fracType:
+      out << k << ") : " << v << " (fraction) - offset = " << v->getOffset() << '\n';
+      break;
+    default:
+      /* should not occur */
+      out << k << ") : " << v << '\n';
+      break;
+    }
+  }
+}
+
+void HashSymTbl::printPool(OutBuf& out) const {
+  names.printOut(out);
+}
@@ -0,0 +1,121 @@
+#ifndef SYMTBL_HPP_
+#define SYMTBL_HPP_
+
+/**
+ * @file symtbl.hpp
+ * @brief This header file contains the symbol table for identifiers of
+ * any length, which are interned into a pool of strings by the lexer.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "tinycomp.hpp"
+
+/** A pool of interned strings.
+ *
+ *  Each distinct string is stored once, in the blocks of an Arena, and is
+ *  given a dense id (0, 1, 2, ... in order of interning). The ids are found
+ *  through an open-addressing hash table with linear probing, which only
+ *  holds ids (4 bytes per slot) and is kept at most half full; the hash and
+ *  length of each string are kept by id, so that probes compare them before
+ *  the bytes of the string, and growing the table never hashes a string again.
+ *
+ *  The strings are never moved, so their pointers stay valid as long as
+ *  the pool.
+ */
+class StringPool {
+private:
+  Arena chars;
+
+  /* the strings, their hashes and their lengths, by id */
+  std::vector<const char*> strings;
+  std::vector<std::uint32_t> hashes;
+  std::vector<std::size_t> lengths;
+
+  /* the hash table: each slot holds an id + 1, or 0 when free */
+  std::vector<std::uint32_t> slots;
+
+  static std::uint32_t hash(const char* s, std::size_t length);
+  std::size_t probe(const char* s, std::size_t length, std::uint32_t h) const;
+  void grow();
+
+  // Stop the compiler from generating methods of copy the object
+  StringPool(StringPool const& copy);            // Not to be implemented
+  StringPool& operator=(StringPool const& copy); // Not to be implemented
+public:
+  /** Constructor for an empty pool */
+  StringPool();
+
+  /** Returns the id of the string of the given length starting at s,
+   *  storing a copy of it in the pool if it was not interned yet.
+   */
+  int intern(const char* s, std::size_t length);
+
+  /** Removes all the strings, so that their ids can be given again */
+  void reset();
+
+  /** Returns the id of the NUL-terminated string s, or -1 if it was never interned */
+  int find(const char* s) const;
+
+  /** Returns the (NUL-terminated) string with the given id */
+  const char* getString(int id) const { return strings[id]; }
+
+  /** Returns the number of strings in the pool */
+  int getSize() const { return (int)strings.size(); }
+
+  /** Prints out the memory used by the pool */
+  void printOut(OutBuf& out) const;
+};
+
+/** A symbol table for identifiers of any length.
+ *  The lexer interns each identifier (see intern()) and hands the parser
+ *  its id, so the grammar actions look variables up by id, in an array;
+ *  a lexeme is only hashed once, the first time it is met.
+ */
+class HashSymTbl : public SymTbl {
+private:
+  StringPool names;
+
+  /* the variables, by id of their name (NULL for undeclared names) */
+  std::vector<VarAddress*> sym;
+public:
+  /** Constructor for an empty symbol table, whose variables are stored in mem */
+  HashSymTbl(Memory& mem);
+
+  /** Removes all the names and variables.
+   *  The variables themselves are owned by the arena of the compilation.
+   */
+  void reset();
+
+  /** Interns a lexeme of the given length, returning its id */
+  int intern(const char* lexeme, std::size_t length);
+
+  /** Returns an entry, indexed by its lexeme (NULL if undeclared) */
+  VarAddress* get(const char* lexeme);
+
+  /** Returns an entry, indexed by the id of its lexeme (NULL if undeclared) */
+  VarAddress* get(int id) { return sym[id]; }
+
+  /** Stores a variable in the symbol table, given its lexeme and type */
+  void put(const char* lexeme, typeName type);
+
+  /** Stores a variable in the symbol table, given the id of its lexeme and its type */
+  void put(int id, typeName type);
+
+  /** Fills vars with the variables declared, in alphabetical order of their names */
+  void getVariables(vector<VarAddress*>& vars);
+
+  /** Prints out the symbol table */
+  void printOut(OutBuf& out);
+
+  /** Prints out the current value of every variable, as found in memory.
+   *  Used after the program has been executed.
+   */
+  void printValues(OutBuf& out);
+
+  /** Prints out the memory used by the names of the variables */
+  void printPool(OutBuf& out) const;
+};
+
+#endif //SYMTBL_HPP_
@@ -1,8 +1,11 @@
 #include <iostream>
 #include <iomanip>
 #include <list>
+#include <algorithm>
 
 #include <cstring>
+#include <stdexcept>
+#include <string>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -44,30 +47,54 @@ ConstAddress::ConstAddress(float f) {
   val.f = f;
 }
 
+ConstAddress::ConstAddress(Fraction q) {
+  type = fracType;
+  val.q = q;
+}
+
 /** Returns the constant's type (as a typeName enum)
  */
 typeName ConstAddress::getType() {
   return type;
 }
 
-const char* ConstAddress::toString() const {
-  char* str = (char*)malloc(10*sizeof(char));
+int ConstAddress::getInt() const {
+  return val.i;
+}
+
+float ConstAddress::getFloat() const {
+  return val.f;
+}
+
+Fraction ConstAddress::getFraction() const {
+  return val.q;
+}
 
+void ConstAddress::printOut(OutBuf& out) const {
   switch(type) {
-  case intType: snprintf(str, 10, "%d", val.i);
+  case intType: out << val.i;
     break;
-  case floatType: snprintf(str, 10, "%2.2f", val.f);
+  case floatType: out.putFloat(val.f, "%2.2f");
     break;
-  default: strncpy(str, "?", 1);
+  case fracType: out << val.q.num << '|' << val.q.denom;
+    break;
+  default: out << "?";
     break;
   }
+}
 
-  return str;
+Operand ConstAddress::toOperand() const {
+  assert(type != fracType);
+
+  if (type == floatType) {
+    return Operand(val.f);
+  }
+  return Operand(constOpd, type, val.i);
 }
 
-/** Constructor: creates a variable address from its id (assuming only 1-char id's).
+/** Constructor: creates a variable address from its id.
  */
-VarAddress::VarAddress(char v, typeName t, int o) {
+VarAddress::VarAddress(const char* v, typeName t, int o) {
   lexeme = v;
 
   type = t;
@@ -108,22 +135,26 @@ int VarAddress::getOffset() {
   return offset;
 }
 
-const char* VarAddress::toString() const {
-  char* str = (char*)malloc(2*sizeof(char));
-  str[0] = lexeme;
-  str[1] = '\0';
+const char* VarAddress::getLexeme() {
+  return lexeme;
+}
+
+void VarAddress::printOut(OutBuf& out) const {
+  out << lexeme;
+}
 
-  return str;
+Operand VarAddress::toOperand() const {
+  return Operand(varOpd, type, offset);
 }
 
 
-/** Constructor: creates a temporary at the specified offset in memory
+/** Constructor: creates a temporary of the given type at the specified offset in memory
  */
-TempAddress::TempAddress(int offset) {
-  // update the counter after using the old value as the "name" of this temporary
-  name = counter++;
+TempAddress::TempAddress(int name, int offset, typeName type) {
+  this->name = name;
 
   this->offset = offset;
+  this->type = type;
 }
 
 /** Returns the pointer to the memory location holding the temporary
@@ -132,14 +163,21 @@ int TempAddress::getOffset() {
   return offset;
 }
 
+/** Returns the type of the value held by the temporary
+ */
+typeName TempAddress::getType() {
+  return type;
+}
+
 /** Concrete method for printing a TempAddress;
  *  it's a concrete implementation of the corresponding abstract method in Address
  */
-const char* TempAddress::toString() const {
-  char* str = (char*)malloc(5*sizeof(char));;
-  sprintf(str, "t%d", name);
+void TempAddress::printOut(OutBuf& out) const {
+  out << 't' << name;
+}
 
-  return str;
+Operand TempAddress::toOperand() const {
+  return Operand(tempOpd, type, offset);
 }
 
 
@@ -148,14 +186,24 @@ const char* TempAddress::toString() const {
  */
 InstrAddress::InstrAddress(int vn) {
   arrayCodeIndex = vn;
+  type = ERROR;
+}
+
+InstrAddress::InstrAddress(int vn, typeName type) {
+  arrayCodeIndex = vn;
+  this->type = type;
 }
 
-const char* InstrAddress::toString() const {
-  char* str = (char*)malloc(10*sizeof(char));
+int InstrAddress::getIndex() const {
+  return arrayCodeIndex;
+}
 
-  snprintf(str, 10, "(%d)", arrayCodeIndex);
+void InstrAddress::printOut(OutBuf& out) const {
+  out << '(' << arrayCodeIndex << ')';
+}
 
-  return str;
+Operand InstrAddress::toOperand() const {
+  return Operand(instrOpd, type, arrayCodeIndex);
 }
 
 /****************************/
@@ -165,40 +213,65 @@ const char* InstrAddress::toString() const {
 /* Memory
  */
 Memory::Memory() {
-  storage = (unsigned char*)malloc(MEMSIZE * sizeof(unsigned char*) );
+  storage = (unsigned char*)calloc(MEMSIZE, sizeof(unsigned char));
+  if (storage == NULL) {
+    throw bad_alloc();
+  }
+  capacity = MEMSIZE;
   offset = 0;
+  temps = 0;
 }
 
-Memory& Memory::getInstance() {
-  // The only instance
-  // Guaranteed to be lazy initialized
-  // Guaranteed that it will be destroyed correctly
-  static Memory instance;
-  return instance;
+Memory::~Memory() {
+  free(storage);
 }
 
-int Memory::store(void* val, int width) {
-  /* offset tells us where free memory begins
-   */
-  unsigned char* begin = storage + offset;
+int Memory::reserve(int width) {
+  // every type is aligned to its width (a power of 2)
+  int begin = (offset + width - 1) & ~(width - 1);
 
-  memcpy(begin, val, width);
+  if (begin + width > capacity) {
+    if (begin + width > MAXSIZE) {
+      throw length_error("memory exhausted: " + to_string(begin + width)
+                         + " bytes needed, at most " + to_string(MAXSIZE) + " available");
+    }
+
+    int newCapacity = capacity;
+    while (newCapacity < begin + width) {
+      newCapacity *= 2;
+    }
+
+    unsigned char* grown = (unsigned char*)realloc(storage, newCapacity);
+    if (grown == NULL) {
+      throw bad_alloc();
+    }
+    memset(grown + capacity, 0, newCapacity - capacity);
+
+    storage = grown;
+    capacity = newCapacity;
+  }
 
-  int oldoffset = offset;
-  offset += width;
+  offset = begin + width;
+  return begin;
+}
+
+int Memory::store(void* val, int width) {
+  int begin = reserve(width);
+
+  memcpy(storage + begin, val, width);
 
-  return oldoffset;
+  return begin;
 }
 
 void* Memory::retrieve(int offset) {
   return (void*)((unsigned char*)storage + offset);
 }
 
-TempAddress* Memory::getNewTemp(int width) {
-  int oldoffset = offset;
-  offset += width;
+TempAddress* Memory::getNewTemp(typeName type) {
+  const int width = Type::width(type);
+  int begin = reserve(width);
 
-  TempAddress* temp = new TempAddress(oldoffset);
+  TempAddress* temp = new TempAddress(temps++, begin, type);
 
   /* keep track of temp for future printout */
   temporaries.push_back(temp);
@@ -207,13 +280,61 @@ TempAddress* Memory::getNewTemp(int width) {
   return temp;
 }
 
+int Memory::getTemps() {
+  return temps;
+}
+
+const list<TempAddress*>& Memory::getTemporaries() {
+  return temporaries;
+}
+
+void Memory::relocateTemps(const unordered_map<int, int>& slots, int top) {
+  list<int>::iterator it2 = tempwidths.begin();
+
+  for (list<TempAddress*>::iterator it1 = temporaries.begin(); it1 != temporaries.end(); ) {
+    unordered_map<int, int>::const_iterator slot = slots.find((*it1)->offset);
+
+    if (slot == slots.end()) {
+      // never used by the code: it takes no memory at all
+      it1 = temporaries.erase(it1);
+      it2 = tempwidths.erase(it2);
+      continue;
+    }
+
+    (*it1)->offset = slot->second;
+    ++it1;
+    ++it2;
+  }
+
+  offset = top;
+}
+
+int Memory::getSize() {
+  return offset;
+}
+
+void Memory::reset() {
+  // the whole storage, since a program may have left values past the
+  // offset (e.g. in the temporaries dropped by relocateTemps())
+  memset(storage, 0, capacity);
+  offset = 0;
+  temps = 0;
+  temporaries.clear();
+  tempwidths.clear();
+}
+
+/* The memory is printed out in lines of 16 bytes, up to the last one in use */
+static int printedSize(int size) {
+  return size > 0 ? (size + 15) & ~15 : 16;
+}
+
 void Memory::hexdump() {
   unsigned char *pc = storage;
 
   unsigned char buff[17];
 
   // Process every byte in the data.
-  for (int i = 0; i < MEMSIZE; i++) {
+  for (int i = 0; i < printedSize(offset); i++) {
     // Multiple of 16 means new line (with line offset).
 
     if ((i % 16) == 0) {
@@ -238,25 +359,18 @@ void Memory::hexdump() {
 
 }
 
-/** Prints out a logical view of the memory.
- * Very dirty implementation. It's only included for debugging purposes.
- */
-void Memory::printOut(SymTbl* tbl) {
-  Address* storedAddresses[Memory::MEMSIZE];
-
-  for (int i = 0; i < Memory::MEMSIZE; i++) {
-    storedAddresses[i] = NULL;
-  }
+void Memory::mapAddresses(SymTbl* tbl, vector<Address*>& map) {
+  map.assign(printedSize(offset), NULL);
 
   // re-map all addresses
-  for (char c = 'a'; c <= 'z'; c++) {
-    VarAddress* v = ((SimpleArraySymTbl*)tbl)->get(c);
-    if (v != NULL) {
-      int offset = v->getOffset();
-
-      for (int i = 0; i < v->getWidth(); i++) {
-        storedAddresses[offset+i] = v;
-      }
+  vector<VarAddress*> vars;
+  tbl->getVariables(vars);
+  for (size_t k = 0; k < vars.size(); k++) {
+    VarAddress* v = vars[k];
+    int offset = v->getOffset();
+
+    for (int i = 0; i < v->getWidth(); i++) {
+      map[offset+i] = v;
     }
   }
 
@@ -267,74 +381,388 @@ void Memory::printOut(SymTbl* tbl) {
 
     int width = (*it2);
 
+    // a location shared by several temporaries is named after the first one
     for (int i = 0; i < width; i++) {
-      storedAddresses[offset+i] = (*it1);
+      if (map[offset+i] == NULL) {
+        map[offset+i] = (*it1);
+      }
     }
 
     ++it2;
   }
+}
 
+/** Prints out a logical view of the memory.
+ * Very dirty implementation. It's only included for debugging purposes.
+ */
+void Memory::printOut(SymTbl* tbl, OutBuf& out) {
+  static const char hex[] = "0123456789abcdef";
+  vector<Address*> storedAddresses;
 
-  for (int i = 0; i < Memory::MEMSIZE; i++) {
+  mapAddresses(tbl, storedAddresses);
+
+  for (int i = 0; i < (int)storedAddresses.size(); i++) {
     // Multiple of 16 means new line (with line offset).
     if ((i % 16) == 0) {
       // Just don't print ASCII for the zeroth line.
       if (i != 0)
-        printf ("\n");
+        out << '\n';
 
       // Output the offset.
-      printf ("  %04x ", i);
+      // (at least 4 hex digits)
+      out << "  ";
+      for (int shift = (i >> 16) ? 20 : 12; shift >= 0; shift -= 4) {
+        out << hex[(i >> shift) & 0xf];
+      }
+      out << ' ';
     }
 
     if (storedAddresses[i] != NULL) {
-      cout << std::setw(3) << storedAddresses[i];
+      size_t start = out.size();
+      out << storedAddresses[i];
+      out.alignRight(start, 3);
     } else {
-      cout << " --";
+      out << " --";
+    }
+  }
+
+  // list the temporaries sharing a location with the one it is named after
+  unordered_map<Address*, vector<TempAddress*> > shared;
+  for (list<TempAddress*>::iterator it = temporaries.begin(); it != temporaries.end(); ++it) {
+    Address* owner = storedAddresses[(*it)->getOffset()];
+    if (owner != *it) {
+      shared[owner].push_back(*it);
+    }
+  }
+
+  for (list<TempAddress*>::iterator it = temporaries.begin(); it != temporaries.end(); ++it) {
+    unordered_map<Address*, vector<TempAddress*> >::iterator s = shared.find(*it);
+    if (s == shared.end()) {
+      continue;
     }
+
+    out << '\n' << "  " << *it << " is shared with";
+    for (size_t i = 0; i < s->second.size(); i++) {
+      out << ' ' << s->second[i];
+    }
+  }
+}
+
+
+/* Profile
+ */
+long long Profile::getTotal() const {
+  long long total = 0;
+  for (size_t i = 0; i < counts.size(); i++) {
+    total += counts[i];
   }
+  return total;
 }
 
 
 /* TargetCode
  */
-TacInstr* TargetCode::gen(TacInstr* instr) {
-  instr->setValueNumber(nextInstr);
-  codeArray[nextInstr] = instr;
+int TargetCode::gen(const TacInstr& instr) {
+  int vn = codeArray.size();
 
-  nextInstr++;
+  codeArray.push_back(instr);
 
-  return instr;
+  return vn;
 }
 
-TacInstr* TargetCode::gen(oprEnum op, Address* operand1, Address* operand2) {
-  return gen(new TacInstr(op, operand1, operand2));
+int TargetCode::gen(oprEnum op, Address* operand1, Address* operand2) {
+  return gen(op, operand1, operand2, nullptr);
 }
 
-TacInstr* TargetCode::gen(oprEnum op, Address* operand1, Address* operand2, Address* temp) {
-  return gen(new TacInstr(op, operand1, operand2, temp));
+int TargetCode::gen(oprEnum op, Address* operand1, Address* operand2, Address* temp) {
+  return gen(TacInstr(op,
+                      operand1 != NULL ? operand1->toOperand() : Operand(),
+                      operand2 != NULL ? operand2->toOperand() : Operand(),
+                      temp != NULL ? temp->toOperand() : Operand()));
 }
 
-TargetCode::TargetCode() {
-  nextInstr = 0;
+TargetCode::TargetCode() : backpatches(0), patched(0) {
+  codeArray.reserve(1024);
 }
 
-TacInstr* TargetCode::getInstr(int i) {
+void TargetCode::reset() {
+  codeArray.clear();
+  backpatches = 0;
+  patched = 0;
+}
+
+TacInstr& TargetCode::getInstr(int i) {
   return codeArray[i];
 }
 
 int TargetCode::getNextInstr() {
-  return nextInstr;
+  return codeArray.size();
+}
+
+PatchList TargetCode::makelist(int i) {
+  codeArray[i].setLink(-1);
+
+  return PatchList(i, i);
+}
+
+PatchList TargetCode::merge(PatchList l1, PatchList l2) {
+  if (l1.empty()) {
+    return l2;
+  }
+  if (l2.empty()) {
+    return l1;
+  }
+
+  codeArray[l1.tail].setLink(l2.head);
+
+  return PatchList(l1.head, l2.tail);
+}
+
+void TargetCode::backpatch(PatchList l, int i) {
+  int instr = l.head;
+
+  backpatches++;
+  while (instr >= 0) {
+    // read the link before patching overwrites it
+    int next = codeArray[instr].getLink();
+    codeArray[instr].patch(i);
+    instr = next;
+    patched++;
+  }
+}
+
+void TargetCode::getJumps(PatchList l, vector<int32_t>& jumps) const {
+  for (int instr = l.head; instr >= 0; instr = codeArray[instr].getLink()) {
+    jumps.push_back(instr);
+  }
+}
+
+void TargetCode::append(const TacInstr* instrs, int n) {
+  codeArray.insert(codeArray.end(), instrs, instrs + n);
 }
 
-void TargetCode::backpatch(list<TacInstr*> l, TacInstr* i) {
-  for(const auto& instr: l) {
-    instr->patch(i);
+int TargetCode::remove(const vector<bool>& dead) {
+  const int n = codeArray.size();
+
+  // newIndex[i] is the number of instructions kept before i, that is the new
+  // index of i, or of the first instruction kept after i when i is removed
+  vector<int> newIndex(n + 1);
+  int kept = 0;
+  for (int i = 0; i < n; i++) {
+    newIndex[i] = kept;
+    if (!dead[i]) {
+      kept++;
+    }
+  }
+  newIndex[n] = kept;
+
+  for (int i = 0; i < n; i++) {
+    if (dead[i]) {
+      continue;
+    }
+
+    TacInstr& instr = codeArray[i];
+    Operand o[3] = { instr.getOperand1(), instr.getOperand2(), instr.getTemp() };
+
+    for (int k = 0; k < 3; k++) {
+      if (o[k].kind == instrOpd) {
+        // only jumps may refer to an instruction that is gone
+        assert(k == 2 || !dead[o[k].val.i]);
+        o[k].val.i = newIndex[o[k].val.i];
+      }
+    }
+    instr.setOperand1(o[0]);
+    instr.setOperand2(o[1]);
+    instr.setTemp(o[2]);
+
+    codeArray[newIndex[i]] = instr;
+  }
+  codeArray.erase(codeArray.begin() + kept, codeArray.end());
+
+  return n - kept;
+}
+
+void TargetCode::findLeaders(vector<bool>& leader) {
+  const int n = codeArray.size();
+
+  leader.assign(n + 1, false);
+  leader[0] = true;
+  for (int i = 0; i < n; i++) {
+    const TacInstr& instr = codeArray[i];
+    if (instr.getDest() >= 0) {
+      leader[instr.getDest()] = true;
+    }
+    if (instr.getOp() == jmpOpr || instr.getOp() == jeOpr
+        || instr.getOp() == condJmpOpr || instr.getOp() == haltOpr) {
+      leader[i + 1] = true;
+    }
+  }
+}
+
+/** Prints out an operand, recovering names of variables and temporaries from
+ *  the map of memory built by Memory::mapAddresses()
+ */
+static OutBuf& printOperand(OutBuf &out, const Operand& o, const vector<Address*>& names) {
+  switch(o.kind) {
+  case constOpd:
+    if (o.type == floatType) {
+      return out.putFloat(o.val.f, "%2.2f");
+    }
+    return out << o.val.i;
+  case varOpd:
+  case tempOpd:
+    return out << names[o.val.i];
+  case instrOpd:
+    return out << '(' << o.val.i << ')';
+  default:
+    return out << '?';
   }
 }
 
-void TargetCode::printOut() {
-  for (int i=0; i< 999 && codeArray[i] != NULL; i++) {
-    cout << codeArray[i] << "\n";
+/** Prints out the target of a jump ('?' if it was never backpatched) */
+static OutBuf& printDest(OutBuf& out, int dest) {
+  if (dest < 0) {
+    return out << '?';
+  }
+  return out << dest;
+}
+
+/** Prints out part as a percentage of whole */
+static OutBuf& printShare(OutBuf& out, long long part, long long whole, const char* fmt) {
+  return out.putFloat(whole > 0 ? 100.0 * part / whole : 0.0, fmt);
+}
+
+void TargetCode::printOut(Memory& mem, SymTbl* tbl, OutBuf& out, const Profile* profile) {
+  vector<Address*> names;
+  mem.mapAddresses(tbl, names);
+
+  const long long total = profile != nullptr ? profile->getTotal() : 0;
+
+  for (size_t i = 0; i < codeArray.size(); i++) {
+    const TacInstr& instr = codeArray[i];
+    Operand op1 = instr.getOperand1(), op2 = instr.getOperand2(), temp = instr.getTemp();
+
+    if (profile != nullptr) {
+      out.putInt(profile->counts[i], 12);
+      printShare(out, profile->counts[i], total, " %5.1f%%  ");
+    }
+    out.putInt(i, 4) << ": ";
+
+    switch(instr.getOp()) {
+    case copyOpr:
+      assert(op1.kind != noOpd);
+      if (op2.kind == noOpd) {
+        out << 't' << i << " = ";
+        printOperand(out, op1, names);
+      } else {
+        printOperand(out, op1, names) << " = ";
+        printOperand(out, op2, names);
+      }
+      break;
+    case fakeOpr:
+    case haltOpr:
+      out << opTable[instr.getOp()];
+      break;
+    case jmpOpr:
+      out << opTable[instr.getOp()] << ' ';
+      printDest(out, instr.getDest());
+      break;
+    case mulOpr:
+    case divOpr:
+    case addOpr:
+      assert(op1.kind != noOpd && op2.kind != noOpd && temp.kind != noOpd);
+      printOperand(out, temp, names) << " = ";
+      printOperand(out, op1, names) << ' ' << opTable[instr.getOp()] << ' ';
+      printOperand(out, op2, names);
+      break;
+    case indexCopyOpr:
+      assert(op1.kind != noOpd && op2.kind != noOpd && temp.kind != noOpd);
+      printOperand(out, temp, names) << '[';
+      printOperand(out, op1, names) << "] = ";
+      printOperand(out, op2, names);
+      break;
+    case offsetOpr:
+      assert(op1.kind != noOpd && op2.kind != noOpd && temp.kind != noOpd);
+      printOperand(out, temp, names) << " = ";
+      printOperand(out, op1, names) << '[';
+      printOperand(out, op2, names) << ']';
+      break;
+    case jeOpr:
+      assert(op1.kind != noOpd && op2.kind != noOpd);
+      out << opTable[instr.getOp()] << ' ';
+      printOperand(out, op1, names) << ' ';
+      printOperand(out, op2, names) << ' ';
+      printDest(out, instr.getDest());
+      if (profile != nullptr) {
+        out << "    (taken " << profile->taken[i] << " times, ";
+        printShare(out, profile->taken[i], profile->counts[i], "%.1f%%)");
+      }
+      break;
+    case condJmpOpr: /* TBD */
+    case UNKNOWNOpr: /* TBD */
+    default:
+      out << "???";
+      break;
+    }
+    out << '\n';
+  }
+}
+
+void TargetCode::printLoops(const Profile& profile, OutBuf& out, int count) {
+  struct Loop {
+    int head;
+    int tail;
+    long long iterations;
+    long long instrs;
+  };
+
+  const int n = codeArray.size();
+
+  // the jumps back to the same instruction (as the one closing a while, and
+  // those from the end of an if in its body, once threaded) make one loop
+  vector<Loop> loops;
+  unordered_map<int, size_t> heads;
+  for (int i = 0; i < n; i++) {
+    const TacInstr& instr = codeArray[i];
+    const int dest = instr.getDest();
+    if ((instr.getOp() != jmpOpr && instr.getOp() != jeOpr) || dest < 0 || dest > i
+        || profile.taken[i] == 0) {
+      continue;
+    }
+
+    unordered_map<int, size_t>::iterator h = heads.find(dest);
+    if (h == heads.end()) {
+      Loop loop = { dest, i, 0, 0 };
+      h = heads.insert(make_pair(dest, loops.size())).first;
+      loops.push_back(loop);
+    }
+    loops[h->second].tail = i;
+    loops[h->second].iterations += profile.taken[i];
+  }
+
+  // ran[i] is the number of instructions run before instruction i
+  vector<long long> ran(n + 1, 0);
+  for (int i = 0; i < n; i++) {
+    ran[i + 1] = ran[i] + profile.counts[i];
+  }
+  for (size_t k = 0; k < loops.size(); k++) {
+    loops[k].instrs = ran[loops[k].tail + 1] - ran[loops[k].head];
+  }
+  stable_sort(loops.begin(), loops.end(),
+              [](const Loop& a, const Loop& b) { return a.instrs > b.instrs; });
+
+  if (loops.empty()) {
+    out << "no loop ran\n";
+  }
+
+  const long long total = profile.getTotal();
+  for (int k = 0; k < (int)loops.size() && k < count; k++) {
+    const Loop& loop = loops[k];
+
+    out.putInt(loop.head, 4) << " - ";
+    out.putInt(loop.tail, 4) << ": " << loop.instrs << " instructions (";
+    printShare(out, loop.instrs, total, "%.1f%%") << "), " << loop.iterations << " iterations, entered "
+      << profile.counts[loop.head] - loop.iterations << " times\n";
   }
 }
 
@@ -349,129 +777,82 @@ void TargetCode::printOut() {
 // 	virtual void put(const char* lexeme) = 0;
 // };
 
-/** Constructor for the SimpleArraySymTbl class
- *  Basically, it just initializes all entries in the table to NULL
+/* TacInstr
  */
-SimpleArraySymTbl::SimpleArraySymTbl() {
-  for (size_t i = 0; i < 26; i++) {
-    // make sure that the table is clean at the beginning
-    sym[i] = NULL;
-  }
+static_assert(sizeof(TacInstr) == 16, "TacInstr is expected to be packed in 16 bytes");
+
+TacInstr::TacInstr(oprEnum op, const Operand& operand1, const Operand& operand2, const Operand& temp) {
+  this->op = op;
+  set(0, operand1);
+  set(1, operand2);
+  set(2, temp);
 }
 
-/** Returns an entry from the Symbol table, using a lexeme (a string) as the key.
- *  In this simple implementation, it just falls back to the 1-char lexeme assumption
- *  (only the first char of the string is used)
- */
-VarAddress* SimpleArraySymTbl::get(const char* lexeme) {
-  return get(lexeme[0]);
+Operand TacInstr::get(int k) const {
+  return Operand((opdKind)(tags[k] & 0xf), (typeName)(tags[k] >> 4), vals[k]);
 }
 
-/** Returns an entry from the Symbol table, assuming that all lexemes are just 1-char long
- */
-VarAddress* SimpleArraySymTbl::get(char lexeme) {
-  int index = lexeme - 'a';
+void TacInstr::set(int k, const Operand& o) {
+  tags[k] = (std::uint8_t)(o.kind | (o.type << 4));
+  vals[k] = o.val.i;
+}
 
-  return sym[index];
+oprEnum TacInstr::getOp() const {
+  return (oprEnum)op;
 }
 
-/** Stores an entry in the Symbol table, using a lexeme (a string) as the key
- *  In this simple implementation, it just falls back to the 1-char lexeme assumption
- *  (only the first char of the string is used)
- */
-void SimpleArraySymTbl::put(const char* lexeme, typeName type) {
-  put(lexeme[0], type);
+Operand TacInstr::getOperand1() const {
+  return get(0);
 }
 
-/** Stores an entry in the Symbol table, assuming that all lexemes are just 1-char long
- */
-void SimpleArraySymTbl::put(char lexeme, typeName type) {
-  int index = lexeme -'a';
+Operand TacInstr::getOperand2() const {
+  return get(1);
+}
 
-  int offset;
+Operand TacInstr::getTemp() const {
+  return get(2);
+}
 
-  // we store variables in memory, initializing them with a default value depending on their type
-  switch(type) {
-  case intType: {
-    int intVal = 0;
-    offset = mem.store(&intVal, sizeof(int));
-  }
-    break;
-  case floatType: {
-    float floatVal = 0;
-    offset = mem.store(&floatVal, sizeof(float));
-  }
-    break;
-  case fracType: {
-    Fraction fracVal(0,0);
-    offset = mem.store(&fracVal, sizeof(Fraction));
-  }
-  default:
-    break;
-  }
+int TacInstr::getDest() const {
+  return (tags[2] & 0xf) == instrOpd ? vals[2] : -1;
+}
 
-  VarAddress* a = new VarAddress(lexeme, type, offset);
-  sym[index] = a;
-}
-
-void SimpleArraySymTbl::printOut() {
-  for (int i = 0; i < 26; ++i)
-    {
-      if (sym[i] != NULL) {
-        switch (sym[i]->getType()) {
-        case intType:
-          cout << i << ") : " << sym[i] << " (int)   - offset = " << sym[i]->getOffset() << endl;
-          break;
-        case floatType:
-          cout << i << ") : " << sym[i] << " (float) - offset = " << sym[i]->getOffset() << endl;
-          break;
-        case fracType:
-          cout << i << ") : " << sym[i] << " (fraction) - offset = " << sym[i]->getOffset() << endl;
-          break;
-        default:
-          /* should not occur */
-          cout << i << ") : " << sym[i] << endl;
-          break;
-        }
-      }
-    }
+void TacInstr::setOperand1(const Operand& o) {
+  set(0, o);
 }
 
-/* TacInstr
- */
-TacInstr::TacInstr(oprEnum op, Address* operand1, Address* operand2, Address* temp) : op(op), operand1(operand1), operand2(operand2) {
-  switch(op)
-  {
-  case jmpOpr:
-  case jeOpr:
-    this->temp = nullptr;
-    this->dest = static_cast<InstrAddress*>(temp);
-    break;
-  default:
-    this->temp = static_cast<TempAddress*>(temp);
-    this->dest = nullptr;
-  }
+void TacInstr::setOperand2(const Operand& o) {
+  set(1, o);
 }
 
-oprEnum TacInstr::getOp() const {
-  return op;
+void TacInstr::setTemp(const Operand& o) {
+  set(2, o);
 }
 
-void TacInstr::setValueNumber(int vn) {
-  valueNumber = new InstrAddress(vn);
+// for backpathcing "goto"-like instructions
+void TacInstr::patch(int vn) {
+  assert(this->getOp() == jmpOpr
+         || this->getOp() == condJmpOpr
+         || this->getOp() == jeOpr);
+
+  set(2, Operand(instrOpd, ERROR, vn));
 }
 
-InstrAddress* TacInstr::getValueNumber() {
-  return valueNumber;
+/* Until it is backpatched, the target field of a jump holds an empty
+ * operand, whose payload links to the next jump in its PatchList.
+ */
+int TacInstr::getLink() const {
+  assert((tags[2] & 0xf) == noOpd);
+
+  return vals[2];
 }
 
-// for backpathcing "goto"-like instructions
-void TacInstr::patch(TacInstr* i) {
-  assert(this->getOp() == jmpOpr 
+void TacInstr::setLink(int vn) {
+  assert(this->getOp() == jmpOpr
          || this->getOp() == condJmpOpr
          || this->getOp() == jeOpr);
 
-  this->dest = i->getValueNumber();
+  set(2, Operand(noOpd, ERROR, vn));
 }
 
 
@@ -481,8 +862,8 @@ void TacInstr::patch(TacInstr* i) {
 
 /** Constructor for ExprAttr, when the expression actually refers to an instruction
  */
-ExprAttr::ExprAttr(TacInstr* addr, typeName type) {
-  this->addr = addr->getValueNumber();
+ExprAttr::ExprAttr(int addr, typeName type) {
+  this->addr = new InstrAddress(addr, type);
   this->type = type;
 }
 
@@ -513,59 +894,27 @@ Address* ExprAttr::getAddr(){
   return addr;
 }
 
+ConstAddress* ExprAttr::getConst() {
+  return dynamic_cast<ConstAddress*>(addr);
+}
+
 typeName ExprAttr::getType() {
   return type;
 }
 
 /* BoolAttr
  */
-void BoolAttr::addTrue(TacInstr* instr) {
-  // check: must be a goto
-  assert(instr->getOp() == jmpOpr 
-         || instr->getOp() == condJmpOpr
-         || instr->getOp() == jeOpr);
-
-  truelist.push_back(instr);
-}
-
-void BoolAttr::addFalse(TacInstr* instr) {
-  // check: must be a goto
-  assert(instr->getOp() == jmpOpr 
-         || instr->getOp() == condJmpOpr
-         || instr->getOp() == jeOpr);
-
-  falselist.push_back(instr);
-}
-
-void BoolAttr::addTrue(list<TacInstr*> l) {
-  // Note: I should also check here for "goto" only
-  truelist.merge(l);
-}
-
-void BoolAttr::addFalse(list<TacInstr*> l) {
-  // Note: I should also check here for "goto" only
-  falselist.merge(l);
-}
-
-list<TacInstr*> BoolAttr::getTruelist() {
+PatchList BoolAttr::getTruelist() {
   return truelist;
 }
 
-list<TacInstr*> BoolAttr::getFalselist() {
+PatchList BoolAttr::getFalselist() {
   return falselist;
 }
 
 /* StmtAttr
  */
-void StmtAttr::addNext(TacInstr* instr) {
-  nextlist.push_back(instr);
-}
-
-void StmtAttr::addNext(list<TacInstr*> l) {
-  nextlist.merge(l);
-}
-
-list<TacInstr*> StmtAttr::getNextlist() {
+PatchList StmtAttr::getNextlist() {
   return nextlist;
 }
 
@@ -573,47 +922,7 @@ list<TacInstr*> StmtAttr::getNextlist() {
 /********************/
 /* PRINTOUT METHODS */
 /********************/
-std::ostream& operator<<(std::ostream &out, const Address *addr) {
-  return out << addr->toString();
-}
-
-std::ostream& operator<<(std::ostream &out, const InstrAddress *addr) {
-  return out << addr->arrayCodeIndex;
-}
-
-std::ostream& operator<<(std::ostream &out, const TacInstr *instr) {
-  switch(instr->getOp()) {
-  case copyOpr:
-    assert(instr->operand1 != NULL);
-    if (instr->operand2 == NULL) {
-      return out << setw(4) << instr->valueNumber << ": " << "t" << instr->valueNumber << " = " << instr->operand1;
-    } else {
-      return out << setw(4) << instr->valueNumber << ": " <<  instr->operand1 << " = " << instr->operand2;
-    }
-  case fakeOpr:
-    return out << setw(4) << instr->valueNumber << ": " << opTable[instr->op];
-  case jmpOpr:
-    assert(instr->dest != NULL);
-    return out << setw(4) << instr->valueNumber << ": " << opTable[instr->op] << " " << instr->dest;
-  case mulOpr:
-  case divOpr:
-  case addOpr:
-    assert(instr->operand1 != NULL && instr->operand2 != NULL && instr->temp != NULL);
-    return out << setw(4) << instr->valueNumber << ": " << instr->temp << " = " << instr->operand1 << " " << opTable[instr->op] << " " << instr->operand2;
-  case indexCopyOpr:
-    assert(instr->operand1 != NULL && instr->operand2 != NULL && instr->temp != NULL);
-    return out << setw(4) << instr->valueNumber << ": " << instr->temp << "[" << instr->operand1 << "] = " << instr->operand2;
-  case offsetOpr:
-    assert(instr->operand1 != NULL && instr->operand2 != NULL && instr->temp != NULL);
-    return out << setw(4) << instr->valueNumber << ": " << instr->temp << " = " << instr->operand1 << "[" << instr->operand2 << "]";
-  case haltOpr:
-    return out << setw(4) << instr->valueNumber << ": " << opTable[instr->op];
-  case jeOpr:
-    assert(instr->operand1 != NULL && instr->operand2 != NULL && instr->dest != NULL);
-    return out << setw(4) << instr->valueNumber << ": " << opTable[instr->op] << " " << instr->operand1 << " " << instr->operand2 << " " << instr->dest;
-  case condJmpOpr: /* TBD */
-  case UNKNOWNOpr: /* TBD */
-  default:
-    return out << setw(4) << instr->valueNumber << ": " << "???";
-  }
+OutBuf& operator<<(OutBuf &out, const Address *addr) {
+  addr->printOut(out);
+  return out;
 }
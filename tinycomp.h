@@ -10,7 +10,9 @@
  * @date 3/13/2017
  */
 
-#include<unordered_map>
+#include<cstddef>
+#include<cstdint>
+#include "arena.hpp"
 
 /** Type system; each native data type is stored as a value in this enumeration.
  *  Note that for structured types we need a more complex structure; also, I am
@@ -42,11 +44,26 @@ typedef enum {
   fakeOpr	/*!< a temporary "fake" operator for simulating the ones yet-to-be implemented */
 } oprEnum;
 
+/** Enums for 3-addr code - kinds of operands, as tagged inside an instruction */
+typedef enum {
+  noOpd,        /*!< no operand (or a jump not yet backpatched) */
+  constOpd,     /*!< an int or float constant, stored by value */
+  varOpd,       /*!< a variable, stored as its offset in memory */
+  tempOpd,      /*!< a temporary, stored as its offset in memory */
+  instrOpd      /*!< an instruction, stored as its index in the code array */
+} opdKind;
+
 /** An empty class representing the attributes of the grammar symbols.
  * It must be specialized for each specific attribute.
+ * Attributes are allocated from the current Arena, and never destroyed.
  */
 class Attribute {
-  /* intentionally empty */
+public:
+  /** Allocates the attribute from the current Arena */
+  static void* operator new(std::size_t size) { return Arena::allocateCurrent(size); }
+
+  /** Attributes are released all at once, by resetting their Arena */
+  static void operator delete(void*) {}
 };
 
 /** Fraction class */
@@ -69,32 +86,104 @@ public:
    : num(_num), denom(_denom) {};
 };
 
-/** Namespace containing type lookup table.
+/** Integer addition, wrapping around on overflow (as the generated code does) */
+inline std::int32_t wrapAdd(std::int32_t x, std::int32_t y) {
+  return (std::int32_t)((std::uint32_t)x + (std::uint32_t)y);
+}
+
+/** Integer multiplication, wrapping around on overflow (as the generated code does) */
+inline std::int32_t wrapMul(std::int32_t x, std::int32_t y) {
+  return (std::int32_t)((std::uint32_t)x * (std::uint32_t)y);
+}
+
+/** Conversion of a float to an int, truncating toward zero. A NaN, or a value
+ *  out of the range of an int, gives INT32_MIN, as the cvttss2si instruction
+ *  (used by the Jit) does; every backend converts by this rule.
+ */
+inline std::int32_t floatToInt(float f) {
+  // both bounds are exact as floats
+  if (f >= -2147483648.0f && f < 2147483648.0f) {
+    return (std::int32_t)f;
+  }
+  return INT32_MIN;
+}
+
+/** Sum of two fractions; the result is not reduced */
+inline Fraction operator+(const Fraction& x, const Fraction& y) {
+  return Fraction(wrapAdd(wrapMul(x.num, y.denom), wrapMul(y.num, x.denom)),
+                  wrapMul(x.denom, y.denom));
+}
+
+/** Product of two fractions; the result is not reduced */
+inline Fraction operator*(const Fraction& x, const Fraction& y) {
+  return Fraction(wrapMul(x.num, y.num), wrapMul(x.denom, y.denom));
+}
+
+/** Quotient of two fractions; the result is not reduced */
+inline Fraction operator/(const Fraction& x, const Fraction& y) {
+  return Fraction(wrapMul(x.num, y.denom), wrapMul(x.denom, y.num));
+}
+
+/** Greatest common divisor, by Stein's binary algorithm: only shifts,
+ *  subtractions and a min/max (which compile to conditional moves) in the loop.
+ */
+inline std::uint32_t binaryGcd(std::uint32_t u, std::uint32_t v) {
+  if (u == 0 || v == 0) {
+    return u | v;
+  }
+  const int shift = __builtin_ctz(u | v);
+  u >>= __builtin_ctz(u);
+  while (v != 0) {
+    v >>= __builtin_ctz(v);
+    std::uint32_t lo = (u < v) ? u : v,
+      hi = (u < v) ? v : u;
+    u = lo;
+    v = hi - lo;
+  }
+  return u << shift;
+}
+
+/** The canonical form of a fraction: num and denom have no common factor,
+ *  and denom is positive (x|0 becomes 1|0 or -1|0; 0|0 is left alone).
+ *  Two canonical fractions have the same value exactly when both their
+ *  halves are equal.
+ */
+inline Fraction reduce(const Fraction& x) {
+  const std::uint32_t n = (x.num < 0) ? 0u - (std::uint32_t)x.num : (std::uint32_t)x.num,
+    d = (x.denom < 0) ? 0u - (std::uint32_t)x.denom : (std::uint32_t)x.denom;
+  const std::uint32_t g = binaryGcd(n, d);
+
+  if (g == 0) {
+    return x;
+  }
+  const bool negative = (x.num < 0) != (x.denom < 0);
+  return Fraction((std::int32_t)(negative ? 0u - n / g : n / g), (std::int32_t)(d / g));
+}
+
+/** Namespace containing the type lattice, evaluated at compile time.
  */
 namespace Type
 {
-  /** Functor for typeName hashing.
+  /** Returns the width in bytes of a value of type t (0 for the codes
+   *  of typeTree that are not types).
+   */
+  constexpr std::size_t width(typeName t) {
+    return t == typeTree::intType ? sizeof(int)
+      : t == typeTree::fracType ? sizeof(Fraction)
+      : t == typeTree::floatType ? sizeof(float)
+      : 0;
+  }
+
+  /** Returns the type that t1 and t2 are both promoted to when they are
+   *  combined (an int becomes a fraction or a float, see typeTree), or
+   *  ERROR if they can not be combined.
    */
-  struct type_name_hash
-  {
-    /** Implements hash function for typeName.
-        @param val a typeName;
-    */
-    std::size_t operator()(const typeName val) const {
-      return static_cast<std::size_t>(val);
-    }
-  };
-
-  /** typedef for typeName -> size mapping. */
-  using TypeSizeMap = std::unordered_map<typeName,std::size_t,type_name_hash>;
-
-  /** Map<typeName,std::size_t> allows for runtime lookup of type widths */
-  static const TypeSizeMap size =
-    {
-      {typeTree::intType, sizeof(int)},
-      {typeTree::fracType, sizeof(Fraction)},
-      {typeTree::floatType, sizeof(float)}
-    };
+  constexpr typeName join(typeName t1, typeName t2) {
+    return t1 == t2 ? t1
+      : (t1 ^ t2) == typeTree::FRACPROMO ? typeTree::fracType
+      : (t1 ^ t2) == typeTree::FLOATPROMO ? typeTree::floatType
+      : typeTree::ERROR;
+  }
 }
 
 #endif
@@ -13,7 +13,11 @@
 
 #include <iostream>
 #include <list>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
 #include "tinycomp.h"
+#include "outbuf.hpp"
 
 using namespace std;
 
@@ -21,6 +25,32 @@ using namespace std;
 /* REPRESENTING ADDRESSES  */
 /* *************************/
 
+/** An operand of a 3-addr code instruction, in the compact form in which
+ *  it is stored inside a TacInstr: a tag (the kind of operand and the
+ *  type of its value) plus a 32-bit payload (see opdKind).
+ */
+class Operand {
+public:
+  /** What the payload refers to */
+  opdKind kind;
+  /** The type of the value (ERROR for jump targets) */
+  typeName type;
+  /** The payload: a constant value, an offset in memory or an index of the code array */
+  union {
+    std::int32_t i;
+    float f;
+  } val;
+
+  /** Constructor for an empty operand */
+  Operand() : kind(noOpd), type(ERROR) { val.i = 0; }
+
+  /** Constructor for an operand with an int payload */
+  Operand(opdKind kind, typeName type, std::int32_t i) : kind(kind), type(type) { val.i = i; }
+
+  /** Constructor for a float constant */
+  Operand(float f) : kind(constOpd), type(floatType) { val.f = f; }
+};
+
 /** A generic address for 3-addr code instructions. This can be:
  * - a constant
  * - a variable (from the symbol table)
@@ -29,14 +59,26 @@ using namespace std;
 class Address {
 protected:
   /** Overloading of the << operator.
-   *  It will print the Address by way of the toString() method
+   *  It will print the Address by way of the printOut() method
+   */
+  friend OutBuf& operator<<(OutBuf &, const Address *);
+
+  /** Abstract method for printing an Address straight into an output buffer.
+   *  Note that printOut() *must* be defined in derived classes.
    */
-  friend std::ostream& operator<<(std::ostream &, const Address *);
+  virtual void printOut(OutBuf& out) const = 0;
+
+public:
+  /** Allocates the address from the current Arena */
+  static void* operator new(std::size_t size) { return Arena::allocateCurrent(size); }
+
+  /** Addresses are released all at once, by resetting their Arena */
+  static void operator delete(void*) {}
 
-  /** Abstract method for printing an Address.
-   *  Note that toString() *must* be defined in derived classes.
+  /** Abstract method for encoding an Address as the Operand stored in a TacInstr.
+   *  Note that toOperand() *must* be defined in derived classes.
    */
-  virtual const char* toString() const = 0;
+  virtual Operand toOperand() const = 0;
 };
 
 /** A specialization of Address to hold a constant
@@ -47,6 +89,7 @@ private:
   union {
     int i;
     float f;
+    Fraction q;
   } val;
 
 public:
@@ -56,21 +99,39 @@ public:
   /** Constructor for a float constant. */
   ConstAddress(float f);
 
+  /** Constructor for a fraction constant.
+   *  Note that a fraction does not fit in a TacInstr, so it must be split into its
+   *  numerator and denominator (both int constants) before being used in the code.
+   */
+  ConstAddress(Fraction q);
+
   /** Returns the constant's type (as a typeName enum)
    */
   typeName getType();
 
+  /** Returns the value of an int constant */
+  int getInt() const;
+
+  /** Returns the value of a float constant */
+  float getFloat() const;
+
+  /** Returns the value of a fraction constant */
+  Fraction getFraction() const;
+
   /** Concrete method for printing a ConstAddress;
    *  it's a concrete implementation of the corresponding abstract method in Address
    */
-  const char* toString() const;
+  void printOut(OutBuf& out) const;
+
+  /** Encodes the constant by value (only int and float constants can be encoded) */
+  Operand toOperand() const;
 };
 
 /** A specialization of Address to hold a variable
  */
 class VarAddress: public Address {
 private:
-  char lexeme;
+  const char* lexeme;
 
   typeName type;
   int width;
@@ -79,9 +140,10 @@ private:
   int offset;
 
 public:
-  /** Constructor: creates a variable address from its id (assuming only 1-char id's).
+  /** Constructor: creates a variable address from its id.
+   *  The id is not copied; it must live as long as the address (see StringPool).
    */
-  VarAddress(char v, typeName t, int offset);
+  VarAddress(const char* v, typeName t, int offset);
 
   /** Returns the variable's type (as a typeName enum)
    */
@@ -95,10 +157,16 @@ public:
    */
   int getOffset();
 
+  /** Returns the name of the variable */
+  const char* getLexeme();
+
   /** Concrete method for printing a VarAddress;
    *  it's a concrete implementation of the corresponding abstract method in Address
    */
-  const char* toString() const;
+  void printOut(OutBuf& out) const;
+
+  /** Encodes the variable as its offset in memory */
+  Operand toOperand() const;
 };
 
 class Memory;
@@ -107,26 +175,34 @@ class Memory;
  */
 class TempAddress: public Address {
 private:
-  static int counter;
-
   int name;
 
   int offset;
 
+  typeName type;
+
   friend Memory;
 
-  /** Constructor: creates a temporary at the specified offset in memory
+  /** Constructor: creates a temporary of the given type at the specified offset in memory,
+   *  named after the number of temporaries created before it
    */
-  TempAddress(int offset);
+  TempAddress(int name, int offset, typeName type);
 public:
   /** Returns the pointer to the memory location holding the temporary
    */
   int getOffset();
 
+  /** Returns the type of the value held by the temporary
+   */
+  typeName getType();
+
   /** Concrete method for printing a TempAddress;
    *  it's a concrete implementation of the corresponding abstract method in Address
    */
-  const char* toString() const;
+  void printOut(OutBuf& out) const;
+
+  /** Encodes the temporary as its offset in memory */
+  Operand toOperand() const;
 };
 
 /** A specialization of Address to hold an instruction.
@@ -135,7 +211,7 @@ class InstrAddress: public Address {
 private:
   int arrayCodeIndex;
 
-  friend std::ostream& operator<<(std::ostream &, const InstrAddress *);
+  typeName type;
 
 public:
   /** Constructor to initialize an InstrAddress from an index of the array code.
@@ -143,7 +219,23 @@ public:
    */
   InstrAddress(int vn);
 
-  const char* toString() const;
+  /** Constructor to initialize an InstrAddress referring to the value computed
+   *  by an instruction.
+   *  @param vn The index of the TargetCode array, representing a valuenumber.
+   *  @param type The type of the value computed by the instruction.
+   */
+  InstrAddress(int vn, typeName type);
+
+  /** Returns the index of the TargetCode array this address refers to */
+  int getIndex() const;
+
+  /** Concrete method for printing an InstrAddress;
+   *  it's a concrete implementation of the corresponding abstract method in Address
+   */
+  void printOut(OutBuf& out) const;
+
+  /** Encodes the instruction as its index in the code array */
+  Operand toOperand() const;
 };
 
 /* **************/
@@ -152,48 +244,92 @@ public:
 
 /** A generic three-address code instruction.
  *  It will store:
- *  - the instruction's valuenumber
  *  - the operator \sa oprEnum
+ *  - up to three operands, tagged and stored inline \sa Operand
+ *
+ *  Instructions are packed in 16 bytes and stored by value in the code
+ *  array, so walking the code does not chase any pointer. The valuenumber
+ *  of an instruction is simply its index in the code array.
  */
 class TacInstr {
 private:
-  InstrAddress* valueNumber;
-  oprEnum op;
-  Address* operand1;
-  Address* operand2;
-  TempAddress* temp;
-  InstrAddress* dest;
-
-  void setValueNumber(int vn);
-  friend class TargetCode;
+  std::uint8_t op;
+  /* kind (low nibble) and type (high nibble) of each operand */
+  std::uint8_t tags[3];
+  std::int32_t vals[3];
 
-  friend std::ostream& operator<<(std::ostream &, const TacInstr *);
-public:
-  /** Constructor of a 3-address code instruction. The result is internally stored
-   * as an InstrAddress representing the value number (e.g corresponding to an index to the code array)
-   * @param op The operator for this instruction, as an oprEnum
-   * @param operand1 The first operand, as a generic Address
-   * @param operand2 The second operand (may be NULL for operators that do not require 2 operands)
-   */
-  TacInstr(oprEnum op, Address* operand1, Address* operand2) : valueNumber(nullptr), op(op), operand1(operand1), operand2(operand2), temp(nullptr), dest(nullptr) {};
+  Operand get(int k) const;
+  void set(int k, const Operand& o);
 
-  /** Constructor of a 3-address code instruction. The result is internally stored
-   * as an InstrAddress representing the value number (e.g corresponding to an index to the code array)
+public:
+  /** Constructor of a 3-address code instruction.
    * @param op The operator for this instruction, as an oprEnum
-   * @param operand1 The first operand, as a generic Address
-   * @param operand2 The second operand (may be NULL for operators that do not require 2 operands)
-   * @param temp Holds a temporary, when explicitly needed to specify the address result, depending on the operation
+   * @param operand1 The first operand
+   * @param operand2 The second operand (empty for operators that do not require 2 operands)
+   * @param temp Holds a temporary, when explicitly needed to specify the address result,
+   *             or the target of a "goto"-like operator, depending on the operation
    */
-  TacInstr(oprEnum op, Address* operand1, Address* operand2, Address* temp);
+  TacInstr(oprEnum op, const Operand& operand1, const Operand& operand2, const Operand& temp);
 
   /** Returns the enum representing the operator of this specific instruction */
   oprEnum getOp() const;
 
-  /** Returns the InstrAddress representing the value number */
-  InstrAddress* getValueNumber();
+  /** Returns the first operand (may be empty) */
+  Operand getOperand1() const;
+
+  /** Returns the second operand (may be empty) */
+  Operand getOperand2() const;
+
+  /** Returns the address where the result is stored: a temporary, or
+   *  a variable for indexed copies (may be empty)
+   */
+  Operand getTemp() const;
+
+  /** Returns the target of a "goto"-like instruction (-1 if not yet backpatched) */
+  int getDest() const;
+
+  /** Replaces the first operand */
+  void setOperand1(const Operand& o);
+
+  /** Replaces the second operand */
+  void setOperand2(const Operand& o);
+
+  /** Replaces the address where the result is stored */
+  void setTemp(const Operand& o);
 
   /** For backpathcing "goto"-like instructions */
-  void patch(TacInstr*);
+  void patch(int vn);
+
+  /** Returns the next jump in the PatchList this (not yet backpatched) jump belongs to,
+   *  or -1 if it is the last one.
+   */
+  int getLink() const;
+
+  /** Sets the next jump in the PatchList this (not yet backpatched) jump belongs to */
+  void setLink(int vn);
+};
+
+/** A list of "goto"-like instructions, waiting to be backpatched.
+ *  Following the classic technique, the list is threaded through the
+ *  (still unused) target fields of the jumps themselves: a PatchList
+ *  only stores the valuenumbers of the first and last jump, so it never
+ *  allocates, and merging two lists takes constant time.
+ *  Lists are built and merged by TargetCode::makelist() and TargetCode::merge().
+ */
+class PatchList {
+private:
+  int head;
+  int tail;
+
+  friend class TargetCode;
+
+  PatchList(int head, int tail) : head(head), tail(tail) {}
+public:
+  /** Constructor for an empty list */
+  PatchList() : head(-1), tail(-1) {}
+
+  /** Returns true when there are no jumps in the list */
+  bool empty() const { return head < 0; }
 };
 
 /* ***************************/
@@ -209,6 +345,9 @@ private:
   /* our (simulation of the) actual memory */
   unsigned char* storage;
 
+  /* the number of bytes currently allocated for storage */
+  int capacity;
+
   /* the pointer to the next block of free memory */
   int offset;
 
@@ -217,29 +356,41 @@ private:
   list<TempAddress*> temporaries;
   list<int> tempwidths;
 
-  /** Private Constructor
+  /* the number of temporaries created so far (including the relocated ones) */
+  int temps;
+
+  /** Reserves width bytes at the first free location aligned to width,
+   *  growing the storage as needed. Returns the offset of the reserved bytes.
    */
-  Memory();
+  int reserve(int width);
 
   // Stop the compiler from generating methods of copy the object
   Memory(Memory const& copy);            // Not to be implemented
   Memory& operator=(Memory const& copy); // Not to be implemented
 public:
-  /** The size of our memory in bytes.
-   *  It's set to a very small value to keep visualization of the
-   *  memory dump clean. Increase as needed.
+  /** The initial size of our memory in bytes.
+   *  It's set to a very small value; the memory is doubled whenever
+   *  it gets full, up to MAXSIZE bytes.
    */
   static const int MEMSIZE = 128;
 
-  /** As Memory is implemented as a singleton, its constructor is private.
-   *  This method is the only way to obtain an instance of Memory.
-   *  It is guaranteed that it will return always the same instance.
+  /** The maximum size of our memory in bytes.
+   *  Running out of it throws a std::length_error.
+   */
+  static const int MAXSIZE = 1 << 24;
+
+  /** Constructor for an empty memory.
+   *  Each program being compiled has its own (see CompilerContext).
    */
-  static Memory& getInstance();
+  Memory();
+
+  /** Destructor; releases the storage */
+  ~Memory();
 
   /** Store the bytes pointed to by val in memory.
    *  Note that we don't pass the type of the variable to be stored, as this
-   *  has no relevance for the memory.
+   *  has no relevance for the memory; the value is aligned to its width,
+   *  which is the natural alignment of every type (see Type::width()).
    *
    *    Returns the *beginning* address of the value just stored.
    */
@@ -248,16 +399,41 @@ public:
   /** Returns the *beginning* address of some value, supposedly stored in memory.
    *  Note that we have no clue about the type of such value, or it's width.
    *  They must be "computed/retrieved" externally.
+   *  The pointer is only valid until the memory grows (by store() or getNewTemp()).
    */
   void* retrieve(int offset);
 
   /** Returns a new temporary address pointing to the first location of available memory
    *  Since we would later need to advance the offset anyway, this methods takes care of this;
-   *  that's why we pass the width of what we're gonna store in that location.
+   *  that's why we pass the type of what we're gonna store in that location (its width
+   *  is given by Type::width(), and is also the alignment of the temporary).
    *
    *  It returns the *beginning* address of the value to be stored therein (i.e. the address of the temporary)
    */
-  TempAddress* getNewTemp(int width);
+  TempAddress* getNewTemp(typeName type);
+
+  /** Returns the number of temporaries created so far (including the ones relocated or dropped) */
+  int getTemps();
+
+  /** Returns the temporaries created so far, in order of creation */
+  const list<TempAddress*>& getTemporaries();
+
+  /** Moves the temporaries to new locations, so that temporaries whose lifetimes
+   *  do not overlap can share the same memory.
+   *  @param slots the new offset of each temporary, indexed by its old offset;
+   *               the temporaries not found in slots are dropped
+   *  @param top the first free location after the relocated temporaries
+   */
+  void relocateTemps(const unordered_map<int, int>& slots, int top);
+
+  /** Returns the number of bytes in use (including padding) */
+  int getSize();
+
+  /** Forgets all the variables and temporaries, and clears the storage,
+   *  so that the memory can be used by another program.
+   *  The storage keeps its capacity.
+   */
+  void reset();
 
   /** Prints out a dump of the memory.
    *  It prints the content of each memory location in hex format.
@@ -266,66 +442,152 @@ public:
    */
   void hexdump();
 
-  /** Prints out a logical view of the memory */
-  void printOut(SymTbl* tbl);
+  /** Fills map (indexed by offset) with the variable or temporary stored at each
+   *  memory location (NULL for free locations). A location shared by several
+   *  temporaries is named after the first one.
+   */
+  void mapAddresses(SymTbl* tbl, vector<Address*>& map);
+
+  /** Prints out a logical view of the memory, followed by the temporaries sharing each location */
+  void printOut(SymTbl* tbl, OutBuf& out);
 };
 
 
+/** The execution counts of the instructions in a TargetCode, gathered by
+ *  the Interpreter when profiling (see Interpreter::setProfile()).
+ */
+struct Profile {
+  /** How many times each instruction ran */
+  vector<long long> counts;
+  /** How many times each jump was taken (as many times as it ran, for a goto) */
+  vector<long long> taken;
+
+  /** Returns the number of instructions run */
+  long long getTotal() const;
+};
+
 /** A simplified abstraction for representing our target code.
  *  Following the textbook, I'm using 3-addr code instructions
- *  and storing them in an actual array.
+ *  and storing them in an actual array, which grows as needed.
  */
 class TargetCode {
 private:
-  TacInstr* codeArray[1000];
-  int nextInstr;
+  vector<TacInstr> codeArray;
+
+  /* the number of calls of backpatch(), and of the instructions they patched */
+  int backpatches;
+  int patched;
 
-  TacInstr* gen(TacInstr* instr);
+  int gen(const TacInstr& instr);
 public:
   /** Basic constructor; it will initialize the internal array of TacInstr instructions */
   TargetCode();
 
-  /** Returns the instruction stored at index i in the code array */
-  TacInstr* getInstr(int i);
+  /** Removes all the instructions, keeping the array allocated */
+  void reset();
+
+  /** Returns the instruction stored at index i in the code array.
+   *  The reference is only valid until the next instruction is generated.
+   */
+  TacInstr& getInstr(int i);
+
+  /** Returns the first instruction of the code array; the others follow it.
+   *  The pointer is only valid until the next instruction is generated.
+   */
+  const TacInstr* getCode() const { return codeArray.data(); }
 
   /** Implementation of "nextinstr" from the textbook */
   int getNextInstr();
 
   /** Implementation of "gen()" from the textbook.
    *  Basically, if generates a new TacInstr with the given parameters,
-   *  and stores it in the next available place in the code array
+   *  and stores it in the next available place in the code array.
+   *  Returns the valuenumber (index) of the new instruction.
    */
-  TacInstr* gen(oprEnum op, Address* operand1, Address* operand2);
+  int gen(oprEnum op, Address* operand1, Address* operand2);
 
   /** Implementation of "gen()" from the textbook.
    *  Basically, if generates a new TacInstr with the given parameters,
    *  and stores it in the next available place in the code array
    *  This version accounts for using temporaries.
+   *  Returns the valuenumber (index) of the new instruction.
+   */
+  int gen(oprEnum op, Address* operand1, Address* operand2, Address* temp);
+
+  /** Implementation of "makelist()" from the textbook.
+   *  @param instr the valuenumber of a "goto"-like instruction, not yet backpatched
+   *  @return a list containing only instr
+   */
+  PatchList makelist(int instr);
+
+  /** Implementation of "merge()" from the textbook; it takes constant time.
+   *  Both lists are consumed, and must not be used anymore.
+   *  @return the concatenation of l1 and l2
    */
-  TacInstr* gen(oprEnum op, Address* operand1, Address* operand2, Address* temp);
+  PatchList merge(PatchList l1, PatchList l2);
 
   /** Implementation of "backpatch()" from the textbook.
-   *  @param gotolist a list of TacInstr; each one is assumed to be a "goto"-like instruction
-   *  @param instr the Address of the instruction (i.e. TacInstr) to be patched in the goto's in the list
+   *  @param gotolist a list of "goto"-like instructions
+   *  @param instr the valuenumber of the instruction to be patched in the goto's in the list
+   */
+  void backpatch(PatchList gotolist, int instr);
+
+  /** Adds the instructions in gotolist to jumps, in the order backpatch() patches them */
+  void getJumps(PatchList gotolist, vector<int32_t>& jumps) const;
+
+  /** Appends n instructions, copied as they are (see Checkpoints::restore()) */
+  void append(const TacInstr* instrs, int n);
+
+  /** Returns the number of calls of backpatch() since the last reset */
+  int getBackpatches() const { return backpatches; }
+
+  /** Returns the number of instructions patched by backpatch() since the last reset */
+  int getPatched() const { return patched; }
+
+  /** Removes the instructions flagged in dead, renumbering the ones that are left.
+   *  A jump to a removed instruction is redirected to the first instruction that
+   *  follows it; no operand may still refer to the value of a removed instruction.
+   *  @param dead one flag per instruction in the code array
+   *  @return the number of instructions removed
+   */
+  int remove(const vector<bool>& dead);
+
+  /** Finds the basic blocks of the code: leader[i] is set when instruction i
+   *  begins a block (the first instruction, the target of a jump and the
+   *  instruction following a jump or a HALT).
+   *  @param leader one flag per instruction, plus one for the end of the code
+   */
+  void findLeaders(vector<bool>& leader);
+
+  /** A convenience method to print out the entire code array.
+   *  The memory and the symbol table are needed to recover the names of variables and temporaries.
+   *  With a profile, each instruction is preceded by how many times it ran (and which
+   *  share of all the instructions run that is), and each je is followed by how many
+   *  times it was taken.
    */
-  void backpatch(list<TacInstr*> gotolist, TacInstr* instr);
+  void printOut(Memory& mem, SymTbl* tbl, OutBuf& out, const Profile* profile = nullptr);
 
-  /** A convenience method to print out the entire code array */
-  void printOut();
+  /** Prints out the loops (the code from the target of a jump back to the jump)
+   *  in which most instructions ran, hottest first.
+   *  @param profile the counts gathered by running this code
+   *  @param count the number of loops to print out, at most
+   */
+  void printLoops(const Profile& profile, OutBuf& out, int count);
 };
 
 /** An abstraction for the Symbol Table
  */
 class SymTbl {
 private:
-  friend void Memory::printOut(SymTbl* tbl);
+  friend void Memory::printOut(SymTbl* tbl, OutBuf& out);
 
 protected:
   /** A reference to the (simulated) memory */
-  Memory& mem = Memory::getInstance();
+  Memory& mem;
 
 public:
-  SymTbl() {}
+  /** Constructor; binds the symbol table to the memory its variables are stored in */
+  SymTbl(Memory& mem) : mem(mem) {}
 
   /** Pure virtual method; retrieves a variable from the symbol table.
    *  @param lexeme The lexeme used as a key to access the symbol table
@@ -338,47 +600,18 @@ public:
    */
   virtual void put(const char* lexeme, typeName type) = 0;
 
-  /** Prints out the symbol table */
-  void printOut() {};
-};
-
-/** A simple implementation for a symbol table.
- *  I assume here that var id's are 1-char long,
- *  so the table is just an array with 26 entries.
- */
-class SimpleArraySymTbl : public SymTbl {
-private:
-  VarAddress *sym[26];
-public:
-  /** Constructor for the SimpleArraySymTbl class
-   *  Basically, it just initializes all entries in the table to NULL
+  /** Pure virtual method; fills vars with the variables stored in the symbol table.
+   *  @param vars The variables, in the order in which they are printed out
    */
-  SimpleArraySymTbl();
-
-  /** Returns an entry, indexed by its lexeme */
-  VarAddress* get(const char* lexeme);
-
-  /** Returns an entry, indexed by its lexeme (1-char version) */
-  VarAddress* get(char lexeme);
+  virtual void getVariables(vector<VarAddress*>& vars) = 0;
 
-  /** Stores a variable in the symbol table, given its lexeme and type  */
-  void put(const char* lexeme, typeName type);
-
-  /** Stores a variable in the symbol table, given its lexeme (1-char version) and type  */
-  void put(char lexeme, typeName type);
+  /** Prints out the symbol table */
+  void printOut(OutBuf&) {}
 
-  /** Returns the value of a variable by first recovering the offset, and then accessing the memory.
-   *  Since we don't know the type to be returned, a (void*) is used.
+  /** Prints out the value of the given type stored at val, as printed out
+   *  for each variable after the program has been executed
    */
-  void* getVarValue(char lexeme) {
-    int off = sym[lexeme]->getOffset();
-    return mem.retrieve(off);
-  }
-  /** Prints out the symbl table */
-  void printOut();
-
-  /** Prints out a logical view of the memory */
-  void printMemory();
+  static void printValue(OutBuf& out, typeName type, const void* val);
 };
 
 /* ******************************/
@@ -403,7 +636,7 @@ public:
    *  that (when executed) will contain the result of the entire expression.
    *  It needs to know (and store) the type of the result.
    */
-  ExprAttr(TacInstr* addr, typeName type);
+  ExprAttr(int addr, typeName type);
 
   /** Constructor for ExprAttr; it will refer to the Address of the variable.
    *  It will infer the type from the type of the variable.
@@ -424,6 +657,9 @@ public:
   /** Returns the E.addr attribute */
   Address* getAddr();
 
+  /** Returns E.addr if the expression is a constant (which happens after folding), NULL otherwise */
+  ConstAddress* getConst();
+
   /** Returns the E.type attribute */
   typeName getType();
 };
@@ -434,42 +670,21 @@ public:
  */
 class BoolAttr: public Attribute {
 private:
-  list<TacInstr*> truelist;
-  list<TacInstr*> falselist;
+  PatchList truelist;
+  PatchList falselist;
 public:
-  BoolAttr() {}
-
-  /** Appends a 3-addr code instruction to the truelist.
-   *
-   *  @param instr The instruction to be appended; it is assumed to contain a "goto"-like operator.
-   */
-  void addTrue(TacInstr* instr);
-
-  /** Appends a 3-addr code instruction to the falselist.
+  /** Constructor for BoolAttr.
    *
-   * @param instr The instruction to be appended; it is assumed to contain a "goto"-like operator.
+   *  @param truelist The jumps to be taken when the expression is true.
+   *  @param falselist The jumps to be taken when the expression is false.
    */
-  void addFalse(TacInstr*instr);
-
-  /** Appends a list of instructions to the truelist.
-   *  Basically, an implementation of merge() for a truelist.
-   *  @param l The list to be appended; it is assumed to contain only "goto"-like instructions.
-   *
-   */
-  void addTrue(list<TacInstr*> l);
-
-  /** Appends a list of instructions to the falselist.
-   *  Basically, an implementation of merge() for a falselist.
-   *  @param l The list to be appended; it is assumed to contain only "goto"-like instructions.
-   *
-   */
-  void addFalse(list<TacInstr*> l);
+  BoolAttr(PatchList truelist, PatchList falselist) : truelist(truelist), falselist(falselist) {}
 
   /** Returns the truelist. */
-  list<TacInstr*> getTruelist();
+  PatchList getTruelist();
 
   /** Returns the falselist. */
-  list<TacInstr*> getFalselist();
+  PatchList getFalselist();
 };
 
 /** Implementation of attribute for grammar symbol stmt: a generic statement.
@@ -477,21 +692,19 @@ public:
  */
 class StmtAttr: public Attribute {
 private:
-  list<TacInstr*> nextlist;
+  PatchList nextlist;
 public:
+  /** Constructor for a statement with an empty nextlist */
   StmtAttr() {}
 
-  /** Appends an instruction to the nextlist */
-  void addNext(TacInstr*);
-
-  /** Appends a list of instructions to the next list.
-   *  Basically, an implementation of merge() for a nextlist.
-   *  @param l The list to be appended; it is assumed to contain only "goto"-like instructions.
+  /** Constructor for StmtAttr.
+   *
+   *  @param nextlist The jumps to the statement following this one.
    */
-  void addNext(list<TacInstr*> l);
+  StmtAttr(PatchList nextlist) : nextlist(nextlist) {}
 
   /** Returns the nextlist. */
-  list<TacInstr*> getNextlist();
+  PatchList getNextlist();
 };
 
 #endif //TINYCOMP_H_
@@ -4,16 +4,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <assert.h>
+#include <string>
+#include <vector>
+#include <memory>
 #include "tinycomp.h"
 #include "tinycomp.hpp"
+#include "context.hpp"
+#include "batch.hpp"
+#include "server.hpp"
+#include "image.hpp"
 
   using namespace std;
-  /* Prototypes - for lex */
-  int yylex(void);
-  void yyerror(const char *s);
-
-  void printout();
 
   /* Mapping of types to their names */
   const char* typestrs[] = {
@@ -21,14 +22,24 @@
     "floating point",
     "fraction"
   };
+  %}
 
-  int TempAddress::counter = 0;
+/* The parser is reentrant: all the state of a compilation is in the
+ * CompilerContext it is given, and the scanner is reentrant as well.
+ */
+%define api.pure full
+%code requires {
+  class CompilerContext;
+  typedef void* yyscan_t;
+}
+%parse-param {CompilerContext* ctx} {yyscan_t scanner}
+%lex-param {yyscan_t scanner}
 
-  /* Global variables */
-  Memory& mem = Memory::getInstance();
-  SimpleArraySymTbl *sym = new SimpleArraySymTbl();
-  TargetCode *code = new TargetCode();
-  %}
+%code {
+  /* Prototypes - for lex */
+  int yylex(YYSTYPE* lvalp, yyscan_t scanner);
+  void yyerror(CompilerContext* ctx, yyscan_t scanner, const char *s);
+}
 
 /* This is the union that defines the type for var yylval,
  * which corresponds to 'lexval' in our textboox parlance.
@@ -41,7 +52,7 @@
    Fraction fracValue;
 
    /* tokens for other lexemes (var id's and generic lexemes) */
-   char idLexeme;                          /* identifiers */
+   int idLexeme;                           /* identifiers, as the ids of their interned lexemes */
    typeName typeLexeme;                    /* lexemes for type id's */
 
    /* types for other syntactical elements: typically, attributes of the symbols */
@@ -51,6 +62,8 @@
 
 %token <idLexeme>ID <iValue>INTEGER <fValue>FLOAT <fracValue>FRACTION <typeLexeme>TYPE
 %token STAT
+/* handed out by the scanner in place of the statements a parse resumes after (see Checkpoints) */
+%token RESUME
 
 %token TRUE FALSE
 
@@ -67,19 +80,52 @@
 %type <attrs>expr
 %type <attrs>stmt
 %type <attrs>stmt_list
+%type <attrs>stmts
 %type <attrs>cond
 
 %%
 prog: 
-decls stmt_list 
+decls stmts 
 {
   // add the final 'halt' instruction
-  TacInstr *i = code->gen(haltOpr, nullptr, nullptr);
-  code->backpatch(((StmtAttr *)$2)->getNextlist(), i);
+  int i = ctx->code.gen(haltOpr, nullptr, nullptr);
+  ctx->code.backpatch(((StmtAttr *)$2)->getNextlist(), i);
 
-  // print out the output IR, as well as some other info
-  // useful for debugging
-  printout();
+  // the output IR is printed out (or run) by main(), once parsing is over
+}
+;
+
+/* The statements of the program, as stmt_list, but with a checkpoint after
+   each one. The ';' of a statement is reduced at once (no lookahead is read),
+   so ctx->semicolon is still the one ending it.
+ */
+stmts:
+stmt ';'
+{
+  if (ctx->checkpoints != nullptr) {
+    ctx->checkpoints->statement(ctx->semicolon, ctx->code, ctx->mem, ((StmtAttr *)$1)->getNextlist());
+  }
+
+  $$ = $1;
+}
+| RESUME
+{
+  // the statements left unchanged since the checkpoint
+  $$ = new StmtAttr(ctx->checkpoints->restore(ctx->code, ctx->mem));
+}
+| stmts
+{
+  $<inhAttr>$ = ctx->code.getNextInstr();
+}
+stmt ';'
+{
+  ctx->code.backpatch(((StmtAttr *)$1)->getNextlist(), $<inhAttr>2);
+
+  if (ctx->checkpoints != nullptr) {
+    ctx->checkpoints->statement(ctx->semicolon, ctx->code, ctx->mem, ((StmtAttr *)$3)->getNextlist());
+  }
+
+  $$ = $3;
 }
 ;
 
@@ -90,16 +136,21 @@ decls decl
 
 decl: 
 TYPE id_list ';'
+{
+  if (ctx->checkpoints != nullptr) {
+    ctx->checkpoints->declaration(ctx->semicolon);
+  }
+}
 ;
 
 id_list: 
 id_list ',' ID
 {
-  sym->put($3, $<typeLexeme>0);
+  ctx->sym.put($3, $<typeLexeme>0);
 }
 | ID
 {
-  sym->put($1, $<typeLexeme>0);
+  ctx->sym.put($1, $<typeLexeme>0);
 }
 ;
 
@@ -110,11 +161,11 @@ stmt ';'
 }
 | stmt_list
 {
-  $<inhAttr>$ = code->getNextInstr();
+  $<inhAttr>$ = ctx->code.getNextInstr();
 }
 stmt ';'
 {
-  code->backpatch(((StmtAttr *)$1)->getNextlist(), code->getInstr($<inhAttr>2));
+  ctx->code.backpatch(((StmtAttr *)$1)->getNextlist(), $<inhAttr>2);
 
   $$ = $3;
 }
@@ -123,108 +174,58 @@ stmt ';'
 stmt:
 STAT
 {
-  code->gen(fakeOpr, nullptr, nullptr);
+  ctx->code.gen(fakeOpr, nullptr, nullptr);
 
   $$ = new StmtAttr();
 }
 | ID ASSIGN expr        // ID := EXPR
 {
-  VarAddress* var = sym->get($1);
+  VarAddress* var = ctx->sym.get($1);
 
   if(var == nullptr) {
-    yyerror("Uninitialized variable");
-    assert(false);
+    yyerror(ctx, scanner, "Uninitialized variable");
+    YYABORT;
   }
 
-  const int width = Type::size.at(var->getType());
-  ExprAttr* ex = static_cast<ExprAttr*>($3);
-  // See tinycomp.h for typeTree promotion conditions
-  // Compute promotion type
-  const typeName promo = static_cast<typeName>(var->getType() ^ ex->getType());
-
-  // Determine which instructions are necessary based on the types
-  if(promo == typeTree::IDENTITY || promo == typeTree::FLOATPROMO) {
-    if(var->getType() != typeTree::fracType) {
-      code->gen(copyOpr, var, ex->getAddr());
-    }
-    else {
-      /** Use two temporaries to copy fraction expression numerator
-          and denominator into the variable numerator and denominator.
-          Two constants are necessary for variable offsets.
-          num = 0
-          denom = sizeof(Fraction)/2
-          u = ex[num]
-          v = ex[denom]
-          var[num] = u
-          var[denom] = v
-       */
-      TempAddress * u = mem.getNewTemp(width/2),
-        * v = mem.getNewTemp(width/2);
-      ConstAddress * num = new ConstAddress(0),
-        * denom = new ConstAddress(width/2);
-      code->gen(offsetOpr, ex->getAddr(), num, u);
-      code->gen(offsetOpr, ex->getAddr(), denom, v);
-      code->gen(indexCopyOpr, num, u, var);
-      code->gen(indexCopyOpr, denom, v, var);
-    }
-  }
-  else if(var->getType() == typeTree::fracType && ex->getType() == typeTree::intType) {
-    /** Promote the integer expression to a fraction and copy
-        the value into the variable using appropriate offsets.
-        Two constants are necessary for variable offsets.
-        num = 0
-        denom = sizeof(Fraction)/2
-        var[num] = ex
-        var[denom] = 1
-    */
-    ConstAddress * num = new ConstAddress(0),
-      * denom = new ConstAddress(width/2);
-    code->gen(indexCopyOpr, num, ex->getAddr(), var);
-    code->gen(indexCopyOpr, denom, new ConstAddress(1), var);
-  }
-  else {
-    yyerror("Type mismatch");
-    assert(false);
+  // See emitter.cpp for the conversions between types
+  if(!ctx->emitter.assign(var, static_cast<ExprAttr*>($3))) {
+    yyerror(ctx, scanner, "Type mismatch");
+    YYABORT;
   }
 
   $$ = new StmtAttr();
 }
 | WHILE '('          // while(
 {
-  $<inhAttr>$ = code->getNextInstr();
+  $<inhAttr>$ = ctx->code.getNextInstr();
 }
 cond ')'             // COND)
 {
-  $<inhAttr>$ = code->getNextInstr();
+  $<inhAttr>$ = ctx->code.getNextInstr();
 }
 '{' stmt_list '}'    // { BODY }
 {
-  code->backpatch(((BoolAttr *)$4)->getTruelist(), code->getInstr($<inhAttr>6));
-
-  TacInstr* i = code->gen(jmpOpr, nullptr, nullptr, code->getInstr($<inhAttr>3)->getValueNumber());
+  ctx->code.backpatch(((BoolAttr *)$4)->getTruelist(), $<inhAttr>6);
 
-  code->backpatch(((StmtAttr *)$8)->getNextlist(), i);
+  int i = ctx->code.gen(jmpOpr, nullptr, nullptr, new InstrAddress($<inhAttr>3));
 
-  StmtAttr *attrs = new StmtAttr();
-  attrs->addNext(((BoolAttr *)$4)->getFalselist());
+  ctx->code.backpatch(((StmtAttr *)$8)->getNextlist(), i);
 
-  $$ = attrs;
+  $$ = new StmtAttr(((BoolAttr *)$4)->getFalselist());
 }
 | IF '(' cond ')'      // if ( COND )
 {
-  $<inhAttr>$ = code->getNextInstr();
+  $<inhAttr>$ = ctx->code.getNextInstr();
 }
 THEN '{' stmt_list '}'
 {
   /** Essentially the while loop without the jump back to check the
       condition added to the end of the stmt_list body.
    */
-  code->backpatch(((BoolAttr *)$3)->getTruelist(), code->getInstr($<inhAttr>5));
-
-  StmtAttr *attrs = new StmtAttr();
-  attrs->addNext(((BoolAttr *)$3)->getFalselist());
+  ctx->code.backpatch(((BoolAttr *)$3)->getTruelist(), $<inhAttr>5);
 
-  $$ = attrs;
+  // the statement following the if is reached both when the condition is false and after the body
+  $$ = new StmtAttr(ctx->code.merge(((BoolAttr *)$3)->getFalselist(), ((StmtAttr *)$8)->getNextlist()));
 }
 ;
 
@@ -243,412 +244,217 @@ INTEGER
 }
 | FRACTION
 {
-  /** Fraction constant needs to be loaded into a temporary of the
-      appropriate width. Two constants are necessary for appropriate
-      offsets and two constants are necessary for the fraction
-      numerator and denominator.
-      num = 0
-      denom = sizeof(Fraction)/2
-      temp[num] = $1.num
-      temp[denom] = $1.denom
-   */
-  const int width = Type::size.at(typeTree::fracType);
-  TempAddress * temp = mem.getNewTemp(width);
-  ConstAddress * num = new ConstAddress(0),
-    * denom = new ConstAddress(width/2);
-
-  code->gen(indexCopyOpr, num, new ConstAddress($1.num), temp);
-  code->gen(indexCopyOpr, denom, new ConstAddress($1.denom), temp);
-
-  $$ = new ExprAttr(temp, typeTree::fracType);
+  $$ = ctx->emitter.fraction($1);
 }
 | ID
 {
-  VarAddress *ia = sym->get($1);
+  VarAddress *ia = ctx->sym.get($1);
 
+  if(ia == nullptr) {
+    yyerror(ctx, scanner, "Uninitialized variable");
+    YYABORT;
+  }
   $$ = new ExprAttr(ia);
 }
 | expr '|' expr
 {
-  /** Fraction expression which needs to be placed in a temporary of
-      the appropriate width. Two constants are necessary for offsets
-      into the temporary variable.
-      num = 0
-      denom = sizeof(Fraction) / 2
-      temp[num] = ex1
-      temp[denom] = ex2
-   */
-  const int width = Type::size.at(typeTree::fracType);
-  ExprAttr * ex1 = static_cast<ExprAttr*>($1),
-    * ex2 = static_cast<ExprAttr*>($3);
-  TempAddress * temp = nullptr;
-  ConstAddress * num = new ConstAddress(0),
-    * denom = new ConstAddress(width/2);
-  
-  if(ex1->getType() != typeTree::intType || ex2->getType() != typeTree::intType) {
-    yyerror("Non-integer used within fraction expression");
-    assert(false);
-  }
+  ExprAttr * ex = ctx->emitter.fraction(static_cast<ExprAttr*>($1), static_cast<ExprAttr*>($3));
 
-  temp = mem.getNewTemp(width);
-  code->gen(indexCopyOpr, num, ex1->getAddr(), temp);
-  code->gen(indexCopyOpr, denom, ex2->getAddr(), temp);
-
-  $$ = new ExprAttr(temp, typeTree::fracType);
+  if(ex == nullptr) {
+    yyerror(ctx, scanner, "Non-integer used within fraction expression");
+    YYABORT;
+  }
+  $$ = ex;
 }
 | expr '+' expr
 {
-  ExprAttr * ex1 = static_cast<ExprAttr*>($1),
-    * ex2 = static_cast<ExprAttr*>($3);
-  TempAddress * temp = nullptr;
-  TacInstr * i = nullptr;
-
-  switch(ex1->getType() ^ ex2->getType()) {
-  case typeTree::IDENTITY:
-    {
-      temp = mem.getNewTemp(Type::size.at(ex1->getType()));
-      i = code->gen(addOpr, ex1->getAddr(), ex2->getAddr(), temp);
-      $$ = new ExprAttr(i, ex1->getType());
-      break;
-    }
-  case typeTree::FRACPROMO: /* TBD */
-  case typeTree::FLOATPROMO:
-  default:
-    {
-      yyerror("Type mismatch");
-      assert(false);
-    }
+  // addition
+  ExprAttr * ex = ctx->emitter.arith(addOpr, static_cast<ExprAttr*>($1), static_cast<ExprAttr*>($3));
+
+  if(ex == nullptr) {
+    yyerror(ctx, scanner, "Type mismatch");
+    YYABORT;
   }
+  $$ = ex;
 }
 | expr '/' expr
 {
-  ExprAttr * ex1 = static_cast<ExprAttr*>($1),
-    * ex2 = static_cast<ExprAttr*>($3);
-  TempAddress * temp = nullptr;
-  TacInstr * i = nullptr;
-
-  switch(ex1->getType() ^ ex2->getType())
-    {
-    case typeTree::IDENTITY:
-      {
-        temp = mem.getNewTemp(Type::size.at(ex1->getType()));
-        i = code->gen(divOpr, ex1->getAddr(), ex2->getAddr(), temp);
-        $$ = new ExprAttr(i, ex1->getType());
-        break;
-      }
-    case typeTree::FRACPROMO: /* TBD */
-    case typeTree::FLOATPROMO:
-    default:
-      {
-        yyerror("Type mismatch");
-        assert(false);
-      }
-    }
+  // division
+  ExprAttr * ex = ctx->emitter.arith(divOpr, static_cast<ExprAttr*>($1), static_cast<ExprAttr*>($3));
+
+  if(ex == nullptr) {
+    yyerror(ctx, scanner, "Type mismatch");
+    YYABORT;
+  }
+  $$ = ex;
 }
 | expr '*' expr
 {
   // multiplication
-  ExprAttr * ex1 = static_cast<ExprAttr*>($1),
-    * ex2 = static_cast<ExprAttr*>($3);
-  TempAddress * temp = nullptr;
+  ExprAttr * ex = ctx->emitter.arith(mulOpr, static_cast<ExprAttr*>($1), static_cast<ExprAttr*>($3));
 
-  /** Compute multiplication operation and store result in a
-      temporary of appropriate width.
-   */
-  switch(ex1->getType() ^ ex2->getType()) {
-  case typeTree::IDENTITY:
-    {
-      if(ex1->getType() != typeTree::fracType) {
-        temp = mem.getNewTemp(Type::size.at(ex1->getType()));
-        code->gen(mulOpr, ex1->getAddr(), ex2->getAddr(), temp);
-      }
-      else {
-        /** Two temporaries are necessary for computing the
-            result of the fraction * fraction operation. Two
-            constants are necessary for offsets.
-            num = 0
-            denom = sizeof(Fraction) / 2
-            t = ex1[num]
-            u = ex2[num]
-            t = t * u
-            temp[num] = t
-            (similarly for denominator)
-         */
-        const int width = Type::size.at(typeTree::fracType),
-          offset = width/2;
-        temp = mem.getNewTemp(width);
-        TempAddress * t = mem.getNewTemp(offset),
-          * u = mem.getNewTemp(offset);
-        ConstAddress * num = new ConstAddress(0),
-          * denom = new ConstAddress(offset);
-
-        code->gen(offsetOpr, ex1->getAddr(), num, t);
-        code->gen(offsetOpr, ex2->getAddr(), num, u);
-        code->gen(mulOpr, t, u, t);
-        code->gen(indexCopyOpr, num, t, temp);
-        code->gen(offsetOpr, ex1->getAddr(), denom, t);
-        code->gen(offsetOpr, ex2->getAddr(), denom, u);
-        code->gen(mulOpr, t, u, t);
-        code->gen(indexCopyOpr, denom, t, temp);
-      }
-      $$ = new ExprAttr(temp, ex1->getType());
-      break;
-    }
-  case typeTree::FRACPROMO:
-    {
-      /** Simply multiply numerator of the fraction expression
-          with integer and store denominator directly.
-       */
-      const int width = Type::size.at(typeTree::fracType),
-        offset = width/2;
-      temp = mem.getNewTemp(width);
-      TempAddress * t = mem.getNewTemp(offset),
-        * u = mem.getNewTemp(offset);
-      ConstAddress * num = new ConstAddress(0),
-        * denom = new ConstAddress(offset);
-
-      code->gen(offsetOpr, ex1->getAddr(), num, t);
-      code->gen(offsetOpr, ex2->getAddr(), num, u);
-      code->gen(mulOpr, t, u, t);
-      code->gen(indexCopyOpr, num, t, temp);
-
-      if(ex1->getType() == typeTree::fracType) {
-        code->gen(offsetOpr, ex1->getAddr(), denom, t);
-      }
-      else {
-        code->gen(offsetOpr, ex2->getAddr(), denom, t);
-      }
-      code->gen(indexCopyOpr, denom, t, temp);
-      $$ = new ExprAttr(temp, typeTree::fracType);
-      break;
-    }
-  case typeTree::FLOATPROMO:
-    {
-      /** Simply do the multiplication and promote to float.
-       */
-      temp = mem.getNewTemp(Type::size.at(ex1->getType()));
-      code->gen(mulOpr, ex1->getAddr(), ex2->getAddr(), temp);
-      $$ = new ExprAttr(temp, typeTree::floatType);
-      break;
-    }
-  default:
-    {
-      yyerror("Type mismatch");
-      assert(false);
-    }
+  if(ex == nullptr) {
+    yyerror(ctx, scanner, "Type mismatch");
+    YYABORT;
   }
+  $$ = ex;
 }
 ;
 
 cond:
 TRUE
 {
-  BoolAttr* attrs = new BoolAttr();
-
-  TacInstr* i = code->gen(jmpOpr, nullptr, nullptr);
-  attrs->addTrue(i);
+  int i = ctx->code.gen(jmpOpr, nullptr, nullptr);
 
-  $$ = attrs;
+  $$ = new BoolAttr(ctx->code.makelist(i), PatchList());
 }
 | FALSE
 {
-  BoolAttr* attrs = new BoolAttr();
-
-  TacInstr* i = code->gen(jmpOpr, nullptr, nullptr);
-  attrs->addFalse(i);
+  int i = ctx->code.gen(jmpOpr, nullptr, nullptr);
 
-  $$ = attrs;
+  $$ = new BoolAttr(PatchList(), ctx->code.makelist(i));
 }
 | expr SEQ expr
 {
   // boolean strict equality
-  ExprAttr * ex1 = static_cast<ExprAttr*>($1),
-    * ex2 = static_cast<ExprAttr*>($3);
-  BoolAttr * attrs = new BoolAttr();
-  TacInstr * t = nullptr,
-    * f = nullptr;
-
-  switch(ex1->getType() ^ ex2->getType()) {
-  case typeTree::IDENTITY:
-    {
-      if(ex1->getType() != typeTree::fracType) {
-        /** Generate two jumps, the first is for when the comparison
-            is true and the second is for when the comparison is false.
-         */
-        t = code->gen(jeOpr, ex1->getAddr(), ex2->getAddr(), nullptr);
-        f = code->gen(jmpOpr, nullptr, nullptr);
-        attrs->addTrue(t);
-        attrs->addFalse(f);
-      }
-      else {
-        /** Generate four jumps: the first compares the numerators,
-            the second for when the first fails, the third compares
-            the denominators, and the fourth is for when the third
-            fails. The first needs to be patched to point to the
-            address of the beginning of the block preparing for the
-            third jump.
-        */
-        const int offset = Type::size.at(ex1->getType()) / 2;
-        TempAddress * u = mem.getNewTemp(offset),
-          * v = mem.getNewTemp(offset);
-        ConstAddress * num = new ConstAddress(0),
-          * denom = new ConstAddress(offset);
-        TacInstr * tt = nullptr,
-          * ff = nullptr;
-
-        code->gen(offsetOpr, ex1->getAddr(), num, u);
-        code->gen(offsetOpr, ex2->getAddr(), num, v);
-        t = code->gen(jeOpr, u, v, nullptr);
-        f = code->gen(jmpOpr, nullptr, nullptr);
-        attrs->addFalse(f);
-        tt = code->gen(offsetOpr, ex1->getAddr(), denom, u);
-        t->patch(tt);
-        code->gen(offsetOpr, ex2->getAddr(), denom, v);
-        tt = code->gen(jeOpr, u, v, nullptr);
-        ff = code->gen(jmpOpr, nullptr, nullptr);
-        attrs->addTrue(tt);
-        attrs->addFalse(ff);
-      }
-      break;
-    }
-  default:
-    {
-      yyerror("Type Mismatch");
-      assert(false);
-    }
+  BoolAttr * attrs = ctx->emitter.equal(false, static_cast<ExprAttr*>($1), static_cast<ExprAttr*>($3));
+
+  if(attrs == nullptr) {
+    yyerror(ctx, scanner, "Type Mismatch");
+    YYABORT;
   }
   $$ = attrs;
 }
 | expr REQ expr
 {
   // boolean lax equality
-  ExprAttr * ex1 = static_cast<ExprAttr*>($1),
-    * ex2 = static_cast<ExprAttr*>($3);
-  BoolAttr * attrs = new BoolAttr();
-  TacInstr * t = nullptr,
-    * f = nullptr;
-
-  switch(ex1->getType() ^ ex2->getType()) {
-  case typeTree::IDENTITY:
-    {
-      if(ex1->getType() != typeTree::fracType) {
-        /** Generate two jumps, the first is for when the comparison
-            is true and the second is for when the comparison is false.
-         */
-        t = code->gen(jeOpr, ex1->getAddr(), ex2->getAddr(), nullptr);
-        f = code->gen(jmpOpr, nullptr, nullptr);
-        attrs->addTrue(t);
-        attrs->addFalse(f);
-      }
-      else {
-        /** Generate two jumps: compute the floating point value
-            of ex1[num]/ex1[denom] and ex2[num]/ex2[denom] then
-            compare those values.
-         */
-        const int offset = Type::size.at(typeTree::fracType) / 2;
-        TempAddress * u = mem.getNewTemp(offset),
-          * v = mem.getNewTemp(offset),
-          * w = mem.getNewTemp(offset);
-        ConstAddress * num = new ConstAddress(0),
-          * denom = new ConstAddress(offset);
-
-        code->gen(offsetOpr, ex1->getAddr(), num, u);
-        code->gen(offsetOpr, ex1->getAddr(), denom, v);
-        code->gen(divOpr, u, v, u);
-        code->gen(offsetOpr, ex2->getAddr(), num, v);
-        code->gen(offsetOpr, ex2->getAddr(), denom, w);
-        code->gen(divOpr, v, w, v);
-        t = code->gen(jeOpr, u, v, nullptr);
-        f = code->gen(jmpOpr, nullptr, nullptr);
-        attrs->addTrue(t);
-        attrs->addFalse(f);
-      }
-      break;
-    }
-  case typeTree::FRACPROMO:
-    {
-      /** Generate two jumps: depending on which expression is a
-          fraction, compute the result of ex[num]/ex[denom] then
-          compare the result to the integer expression.
-       */
-      const int offset = Type::size.at(typeTree::fracType) / 2;
-      TempAddress * u = mem.getNewTemp(offset),
-        * v = mem.getNewTemp(offset);
-      ConstAddress * num = new ConstAddress(0),
-        * denom = new ConstAddress(offset);
-
-      if(ex1->getType() == typeTree::fracType) {
-        code->gen(offsetOpr, ex1->getAddr(), num, u);
-        code->gen(offsetOpr, ex1->getAddr(), denom, v);
-        code->gen(divOpr, u, v, u);
-        t = code->gen(jeOpr, u, ex2->getAddr(), nullptr);
-      }
-      else {
-        code->gen(offsetOpr, ex2->getAddr(), num, u);
-        code->gen(offsetOpr, ex2->getAddr(), denom, v);
-        code->gen(divOpr, u, v, u);
-        t = code->gen(jeOpr, u, ex1->getAddr(), nullptr);
-      }
-
-      f = code->gen(jmpOpr, nullptr, nullptr);
-      attrs->addTrue(t);
-      attrs->addFalse(f);
-      break;
-    }
-  case typeTree::FLOATPROMO: /* TBD */
-  default:
-    {
-      yyerror("Type Mismatch");
-      assert(false);
-    }
+  BoolAttr * attrs = ctx->emitter.equal(true, static_cast<ExprAttr*>($1), static_cast<ExprAttr*>($3));
+
+  if(attrs == nullptr) {
+    yyerror(ctx, scanner, "Type Mismatch");
+    YYABORT;
   }
   $$ = attrs;
 }
 | cond OR
 {
-  $<inhAttr>$ = code->getNextInstr();
+  $<inhAttr>$ = ctx->code.getNextInstr();
 } 
 cond
 {
-  code->backpatch(((BoolAttr *)$1)->getFalselist(), code->getInstr($<inhAttr>3));
-
-  BoolAttr* attrs = new BoolAttr();
-  attrs->addTrue(((BoolAttr *)$1)->getTruelist());
-  attrs->addTrue(((BoolAttr *)$4)->getTruelist());
-
-  attrs->addFalse(((BoolAttr *)$4)->getFalselist());
+  ctx->code.backpatch(((BoolAttr *)$1)->getFalselist(), $<inhAttr>3);
 
-  $$ = attrs;
+  $$ = new BoolAttr(ctx->code.merge(((BoolAttr *)$1)->getTruelist(), ((BoolAttr *)$4)->getTruelist()),
+                    ((BoolAttr *)$4)->getFalselist());
 }
 ;
 
 %%
-void printout() {
-  /* ====== */
-  cout << "*********" << endl;
-  cout << "Size of int: " << sizeof(int) << endl;
-  cout << "Size of float: " << sizeof(float) << endl;
-  cout << "Size of Fraction: " << sizeof(Fraction) << endl;
-  cout << "*********" << endl;
-  cout << endl;
-  cout << "== Symbol Table ==" << endl;
-  sym->printOut();
-  cout << endl;
-  cout << "== Memory Dump ==" << endl;
-  // mem.hexdump();
-  mem.printOut(sym);
-  cout << endl;
-  cout << endl;
-  cout << "== Output (3-addr code) ==" << endl;
-  code->printOut();
-  /* ====== */
-}
-
-
-void yyerror(const char *s) {
-  cerr << s << endl;
-}
-
-int main(void) {
-  return yyparse();
+
+void yyerror(CompilerContext* ctx, yyscan_t, const char *s) {
+  ctx->err << s << endl;
+  ctx->errors++;
+}
+
+void usage(const char* name) {
+  cerr << "Usage: " << name << " [--run | --profile | --jit | --emit=c | --emit=image | --lex] [--canonical] [--stats] [-j N] [--cache=DIR] [program...]" << endl;
+  cerr << "       " << name << " --load=IMAGE" << endl;
+  cerr << "       " << name << " --serve=SOCKET [--cache=DIR]" << endl;
+  cerr << "       " << name << " --connect=SOCKET [--run | --profile | --jit | --emit=c | --lex] [--canonical] [--stats] [-n ROUNDS] program..." << endl;
+  cerr << "  (default)    print out the symbol table, memory map and 3-addr code" << endl;
+  cerr << "  --run        execute the 3-addr code and print out the final value of the variables" << endl;
+  cerr << "  --profile    as --run, then print out the 3-addr code with how many times each instruction ran," << endl;
+  cerr << "               and how many times each je jumped, followed by the loops where most instructions ran" << endl;
+  cerr << "  --jit        as --run, but compile the 3-addr code to native code first (x86-64 only)" << endl;
+  cerr << "  --emit=c     print out the 3-addr code as a C program, which prints out the same values as --run" << endl;
+  cerr << "  --emit=image print out the 3-addr code, variables and memory as a binary image, to be run by --load" << endl;
+  cerr << "  --lex        only split the program into tokens, and print out how fast that was" << endl;
+  cerr << "  --canonical  keep fractions reduced, with a positive denominator; == then compares their values exactly" << endl;
+  cerr << "  --stats      print out the time and heap allocations of each phase, and counts of the code, as JSON" << endl;
+  cerr << "  -j N         compile the programs on N threads; the output of each one is printed out in turn" << endl;
+  cerr << "  program...   the files to compile (by default, a single program is read from stdin)" << endl;
+  cerr << "  --cache=DIR  reuse what was printed out for the same program (given as a file, or sent to the server)" << endl;
+  cerr << "               and options, kept in the directory DIR, and resume from the statements it shares with the last" << endl;
+  cerr << "               program with the same declarations; --run runs the cached image of the program, and the cache" << endl;
+  cerr << "               is not used with --profile, --jit, --lex and --stats" << endl;
+  cerr << "  --load=IMAGE  map the image written by --emit=image into memory, and run it as --run does" << endl;
+  cerr << "  --serve=SOCKET    keep running, and compile the programs sent over the Unix socket SOCKET" << endl;
+  cerr << "  --connect=SOCKET  send the programs to the server at SOCKET, and print out what it returns" << endl;
+  cerr << "  -n ROUNDS         send all the programs ROUNDS times, and print out the latency percentiles" << endl;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  int jobs = 1;
+  int rounds = 1;
+  string serve, connect, cacheDir, load;
+  vector<string> files;
+
+  for (int i = 1; i < argc; i++) {
+    if (opt.set(argv[i])) {
+      continue;
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+      jobs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+      rounds = atoi(argv[++i]);
+    } else if (strncmp(argv[i], "--serve=", 8) == 0 && argv[i][8] != '\0') {
+      serve = argv[i] + 8;
+    } else if (strncmp(argv[i], "--connect=", 10) == 0 && argv[i][10] != '\0') {
+      connect = argv[i] + 10;
+    } else if (strncmp(argv[i], "--cache=", 8) == 0 && argv[i][8] != '\0') {
+      cacheDir = argv[i] + 8;
+    } else if (strncmp(argv[i], "--load=", 7) == 0 && argv[i][7] != '\0') {
+      load = argv[i] + 7;
+    } else if (argv[i][0] != '-') {
+      files.push_back(argv[i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (!load.empty()) {
+    Image image;
+    if (!image.map(load.c_str(), cerr)) {
+      return 1;
+    }
+    OutBuf out(cout);
+    return image.run(out, cerr);
+  }
+
+  unique_ptr<Cache> cache;
+  if (!cacheDir.empty()) {
+    cache.reset(new Cache(cacheDir));
+  }
+
+  if (!serve.empty()) {
+    Server server(serve, cerr, cache.get());
+    return server.run();
+  }
+
+  if (!connect.empty()) {
+    if (files.empty()) {
+      usage(argv[0]);
+      return 2;
+    }
+    Client client(connect);
+    return client.replay(files, opt, rounds, cout, cerr);
+  }
+
+  if (!files.empty()) {
+    Batch batch(files, opt, jobs, cache.get());
+    int res = batch.run(cout, cerr);
+    if (cache) {
+      cache->printOut(cerr);
+    }
+    return res;
+  }
+
+  // a program redirected from a file is scanned in place; a pipe is read by flex as usual
+  SourceBuffer source;
+  source.map(fileno(stdin));
+
+  CompilerContext ctx(cerr);
+  OutBuf out(cout);
+  return ctx.compile(stdin, source, opt, out);
 }